@@ -0,0 +1,371 @@
+#ifndef BASIC_QUADTREE_H
+#define BASIC_QUADTREE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+// Box and point in any coordinate type; boxes are closed [x1, x2] x [y1, y2]
+template <class Coord>
+struct BasicBox {
+    Coord x1, y1, x2, y2;
+};
+
+template <class Coord>
+struct BasicPoint {
+    Coord x, y;
+};
+
+// Header-only quadtree specialized at compile time on the coordinate type
+// (int32_t, int64_t, float, double) and the fan-out per axis (2 = quadtree,
+// 4 = 16 children, ...). Every internal node splits into a grid of equal
+// children, so the child holding a point is computed from its offset instead
+// of scanning the children: for FanOut <= 4 by adding up the compares against
+// the child borders, above that by one division per axis. Neither branches.
+//
+// Same rules as QuadtreeNode::Subdivide with scale = FanOut: integer children
+// are ceil(size / FanOut) wide (the last row/column is trimmed or dropped), a
+// point on a shared border belongs to the lower child, nodes are numbered
+// root 1 with each node's children consecutive, and leaves list the partitions
+// overlapping them. Partition IDs are indices into the vector given to Build.
+template <class Coord, int FanOut = 2>
+class BasicQuadtree {
+    static_assert(FanOut >= 2, "FanOut must be at least 2");
+    static_assert(is_arithmetic<Coord>::value, "Coord must be a number type");
+
+public:
+    typedef BasicBox<Coord> Box;
+    typedef BasicPoint<Coord> Point;
+
+    BasicQuadtree() : BasicQuadtree(0, 0, 0, 0) {}
+    BasicQuadtree(Coord x, Coord y, Coord width, Coord height);
+
+    // Rebuilds the tree over partitions; nodes no larger than minW x minH stay
+    // leaves (with stopWhenUniform, so do empty ones and ones inside one partition)
+    void Build(const vector<Box>& partitions, Coord minW, Coord minH, bool stopWhenUniform = false);
+
+    // Node index (node ID - 1) of the leaf holding (x, y), or -1 outside the root
+    int LocateLeaf(Coord x, Coord y) const;
+
+    // Node IDs from the root down to the leaf holding (x, y); false outside the root
+    bool PathToRoot(Coord x, Coord y, vector<int>& path) const;
+
+    // Leaf ID holding (x, y) (-1 outside), with the partitions containing the point in out
+    int SearchPoint(Coord x, Coord y, vector<int>& out) const;
+
+    // Stores / removes one point; the leaf ID, or -1 (outside / not stored)
+    int InsertPoint(Coord x, Coord y);
+    int DeletePoint(Coord x, Coord y);
+
+    // Sorted IDs of partitions overlapping the rectangle (corners in any order)
+    void RectQuery(Coord x1, Coord y1, Coord x2, Coord y2, vector<int>& out) const;
+
+    // Sorted IDs of partitions the segment (x1,y1)-(x2,y2) touches (exact test)
+    void NetIntersect(Coord x1, Coord y1, Coord x2, Coord y2, vector<int>& out) const;
+
+    size_t NodeCount() const { return nodes.size(); }
+    size_t LeafCount() const { return leafPoints.size(); }
+    size_t PointCount() const;
+    const Box& Region(int node) const { return nodes[node].box; }
+    const vector<Point>& PointsAt(int node) const { return leafPoints[nodes[node].leaf]; }
+    size_t MemoryBytes() const;
+
+    // Index of the column (or row) of a node's children holding offset d from
+    // the node's corner, where children are size wide and count of them exist
+    static int ChildSlot(Coord d, Coord size, int count);
+
+    // Exact segment vs. closed box test in Coord, widened so products cannot overflow
+    static bool SegmentHitsBox(Coord xs, Coord ys, Coord xe, Coord ye, const Box& b);
+
+private:
+    // Products of two coordinate differences
+    typedef typename conditional<is_floating_point<Coord>::value, double,
+#ifdef __SIZEOF_INT128__
+            typename conditional<(sizeof(Coord) > 4), __int128, long long>::type
+#else
+            typename conditional<(sizeof(Coord) > 4), long double, long long>::type
+#endif
+            >::type Wide;
+
+    struct Node {
+        Box box;                // Closed region
+        Coord childW, childH;   // Size of every child (internal nodes)
+        int firstChild;         // Children are [firstChild, firstChild + cols * rows), column-major; -1 for leaves
+        int cols, rows;         // Children per axis (up to FanOut)
+        int level;
+        int partBegin, partEnd; // Leaves: partition IDs are pool[partBegin .. partEnd)
+        int leaf;               // Leaves: index into leafPoints
+    };
+
+    vector<Node> nodes;
+    vector<int> pool;
+    vector<Box> boxes;                  // Partitions by ID
+    vector<vector<Point>> leafPoints;   // Stored points of each leaf
+
+    static bool Overlaps(const Box& a, const Box& b) {
+        return max(a.x1, b.x1) < min(a.x2, b.x2) && max(a.y1, b.y1) < min(a.y2, b.y2);
+    }
+    static Coord ChildSize(Coord size) {
+        if (is_integral<Coord>::value) return (size + FanOut - 1) / FanOut;
+        return size / FanOut;
+    }
+    int AddNode(const Box& box, int level);
+    void BuildNode(int n, Coord minW, Coord minH, bool stopWhenUniform, vector<int>& ids);
+    void CollectRect(int n, const Box& q, vector<int>& out) const;
+    void CollectNet(int n, Coord xs, Coord ys, Coord xe, Coord ye, vector<int>& out) const;
+    static void Unique(vector<int>& ids) {
+        sort(ids.begin(), ids.end());
+        ids.erase(unique(ids.begin(), ids.end()), ids.end());
+    }
+};
+
+// ================= Construction ============================
+
+template <class Coord, int FanOut>
+BasicQuadtree<Coord, FanOut>::BasicQuadtree(Coord x, Coord y, Coord width, Coord height) {
+    AddNode({x, y, x + width, y + height}, 0);
+    nodes[0].leaf = 0;
+    leafPoints.emplace_back();
+}
+
+template <class Coord, int FanOut>
+int BasicQuadtree<Coord, FanOut>::AddNode(const Box& box, int level) {
+    Node node;
+    node.box = box;
+    node.childW = node.childH = 0;
+    node.firstChild = -1;
+    node.cols = node.rows = 0;
+    node.level = level;
+    node.partBegin = node.partEnd = 0;
+    node.leaf = -1;
+    nodes.push_back(node);
+    return (int)nodes.size() - 1;
+}
+
+template <class Coord, int FanOut>
+void BasicQuadtree<Coord, FanOut>::Build(const vector<Box>& partitions, Coord minW, Coord minH, bool stopWhenUniform) {
+    Box root = nodes[0].box;
+    nodes.clear();
+    pool.clear();
+    leafPoints.clear();
+    boxes = partitions;
+    AddNode(root, 0);
+    vector<int> ids;
+    for (int pid = 0; pid < (int)boxes.size(); ++pid)
+        if (Overlaps(boxes[pid], root)) ids.push_back(pid);
+    BuildNode(0, minW, minH, stopWhenUniform, ids);
+}
+
+// Children are all created before any is subdivided, which gives the same
+// numbering as QuadtreeNode::Subdivide
+template <class Coord, int FanOut>
+void BasicQuadtree<Coord, FanOut>::BuildNode(int n, Coord minW, Coord minH, bool stopWhenUniform, vector<int>& ids) {
+    Box b = nodes[n].box;
+    Coord w = b.x2 - b.x1, h = b.y2 - b.y1;
+    Coord cw = ChildSize(w), ch = ChildSize(h);
+    bool uniform = ids.empty() || (ids.size() == 1 && boxes[ids[0]].x1 <= b.x1 && boxes[ids[0]].x2 >= b.x2 &&
+                                   boxes[ids[0]].y1 <= b.y1 && boxes[ids[0]].y2 >= b.y2);
+    // Children no smaller than the node (1-unit integer regions) would recurse forever
+    if ((w <= minW && h <= minH) || (stopWhenUniform && uniform) || !(cw > 0 && ch > 0) || (cw >= w && ch >= h)) {
+        nodes[n].partBegin = (int)pool.size();
+        pool.insert(pool.end(), ids.begin(), ids.end());
+        nodes[n].partEnd = (int)pool.size();
+        nodes[n].leaf = (int)leafPoints.size();
+        leafPoints.emplace_back();
+        return;
+    }
+
+    int cols = 0, rows = 0;
+    while (cols < FanOut && b.x1 + cols * cw < b.x2) ++cols;
+    while (rows < FanOut && b.y1 + rows * ch < b.y2) ++rows;
+    int first = (int)nodes.size();
+    for (int i = 0; i < cols; ++i) {
+        for (int j = 0; j < rows; ++j) {
+            Coord cx = b.x1 + i * cw, cy = b.y1 + j * ch;
+            // The last column/row ends at the parent's border (integer rounding)
+            AddNode({cx, cy, i == cols - 1 ? b.x2 : cx + cw, j == rows - 1 ? b.y2 : cy + ch}, nodes[n].level + 1);
+        }
+    }
+    Node& node = nodes[n];
+    node.firstChild = first;
+    node.cols = cols;
+    node.rows = rows;
+    node.childW = cw;
+    node.childH = ch;
+
+    for (int c = first; c < first + cols * rows; ++c) {
+        vector<int> childIDs;
+        for (int pid : ids)
+            if (Overlaps(boxes[pid], nodes[c].box)) childIDs.push_back(pid);
+        BuildNode(c, minW, minH, stopWhenUniform, childIDs);
+    }
+}
+
+// ================= Point location ============================
+
+// Child k spans offsets [k * size, (k + 1) * size]; a border offset goes to the
+// lower child, so the slot is the number of inner borders strictly below d
+template <class Coord, int FanOut>
+int BasicQuadtree<Coord, FanOut>::ChildSlot(Coord d, Coord size, int count) {
+    int slot;
+    if (FanOut <= 4) {
+        slot = 0;
+        for (int k = 1; k < FanOut; ++k) slot += d > k * size;
+    } else if (is_integral<Coord>::value) {
+        slot = (int)((d - (d > 0)) / size);
+    } else {
+        Coord q = d / size;
+        slot = (int)q - ((Coord)(int)q == q);  // ceil(q) - 1 for q >= 0
+        slot = max(slot, 0);
+    }
+    return min(slot, count - 1);
+}
+
+template <class Coord, int FanOut>
+int BasicQuadtree<Coord, FanOut>::LocateLeaf(Coord x, Coord y) const {
+    const Box& root = nodes[0].box;
+    if (x < root.x1 || x > root.x2 || y < root.y1 || y > root.y2) return -1;
+    int n = 0;
+    while (nodes[n].firstChild >= 0) {
+        const Node& node = nodes[n];
+        int i = ChildSlot(x - node.box.x1, node.childW, node.cols);
+        int j = ChildSlot(y - node.box.y1, node.childH, node.rows);
+        n = node.firstChild + i * node.rows + j;
+    }
+    return n;
+}
+
+template <class Coord, int FanOut>
+bool BasicQuadtree<Coord, FanOut>::PathToRoot(Coord x, Coord y, vector<int>& path) const {
+    int leaf = LocateLeaf(x, y);
+    if (leaf < 0) return false;
+    for (int n = 0;;) {
+        path.push_back(n + 1);
+        if (n == leaf) break;
+        const Node& node = nodes[n];
+        n = node.firstChild + ChildSlot(x - node.box.x1, node.childW, node.cols) * node.rows +
+            ChildSlot(y - node.box.y1, node.childH, node.rows);
+    }
+    return true;
+}
+
+template <class Coord, int FanOut>
+int BasicQuadtree<Coord, FanOut>::SearchPoint(Coord x, Coord y, vector<int>& out) const {
+    out.clear();
+    int leaf = LocateLeaf(x, y);
+    if (leaf < 0) return -1;
+    const Node& node = nodes[leaf];
+    for (int k = node.partBegin; k < node.partEnd; ++k) {
+        const Box& p = boxes[pool[k]];
+        if (x >= p.x1 && x <= p.x2 && y >= p.y1 && y <= p.y2) out.push_back(pool[k]);
+    }
+    return leaf + 1;
+}
+
+template <class Coord, int FanOut>
+int BasicQuadtree<Coord, FanOut>::InsertPoint(Coord x, Coord y) {
+    int leaf = LocateLeaf(x, y);
+    if (leaf < 0) return -1;
+    leafPoints[nodes[leaf].leaf].push_back({x, y});
+    return leaf + 1;
+}
+
+template <class Coord, int FanOut>
+int BasicQuadtree<Coord, FanOut>::DeletePoint(Coord x, Coord y) {
+    int leaf = LocateLeaf(x, y);
+    if (leaf < 0) return -1;
+    vector<Point>& pts = leafPoints[nodes[leaf].leaf];
+    for (size_t i = 0; i < pts.size(); ++i) {
+        if (pts[i].x == x && pts[i].y == y) {
+            pts[i] = pts.back();
+            pts.pop_back();
+            return leaf + 1;
+        }
+    }
+    return -1;
+}
+
+template <class Coord, int FanOut>
+size_t BasicQuadtree<Coord, FanOut>::PointCount() const {
+    size_t count = 0;
+    for (const auto& pts : leafPoints) count += pts.size();
+    return count;
+}
+
+template <class Coord, int FanOut>
+size_t BasicQuadtree<Coord, FanOut>::MemoryBytes() const {
+    size_t bytes = nodes.capacity() * sizeof(Node) + pool.capacity() * sizeof(int) +
+                   boxes.capacity() * sizeof(Box) + leafPoints.capacity() * sizeof(vector<Point>);
+    for (const auto& pts : leafPoints) bytes += pts.capacity() * sizeof(Point);
+    return bytes;
+}
+
+// ================ Rectangle / net queries ===================
+
+// Only the children in the column and row range the rectangle reaches are
+// visited; like QuadtreeNode, touching a node's border is not an overlap
+template <class Coord, int FanOut>
+void BasicQuadtree<Coord, FanOut>::CollectRect(int n, const Box& q, vector<int>& out) const {
+    const Node& node = nodes[n];
+    if (node.firstChild < 0) {
+        for (int k = node.partBegin; k < node.partEnd; ++k)
+            if (Overlaps(boxes[pool[k]], q)) out.push_back(pool[k]);
+        return;
+    }
+    const Box& b = node.box;
+    if (!Overlaps(b, q)) return;
+    int i1 = 0, j1 = 0, i2 = node.cols - 1, j2 = node.rows - 1;
+    while (i1 < i2 && b.x1 + (i1 + 1) * node.childW <= q.x1) ++i1;
+    while (i2 > i1 && b.x1 + i2 * node.childW >= q.x2) --i2;
+    while (j1 < j2 && b.y1 + (j1 + 1) * node.childH <= q.y1) ++j1;
+    while (j2 > j1 && b.y1 + j2 * node.childH >= q.y2) --j2;
+    for (int i = i1; i <= i2; ++i)
+        for (int j = j1; j <= j2; ++j) CollectRect(node.firstChild + i * node.rows + j, q, out);
+}
+
+template <class Coord, int FanOut>
+void BasicQuadtree<Coord, FanOut>::RectQuery(Coord x1, Coord y1, Coord x2, Coord y2, vector<int>& out) const {
+    out.clear();
+    Box q = {min(x1, x2), min(y1, y2), max(x1, x2), max(y1, y2)};
+    if (Overlaps(nodes[0].box, q)) CollectRect(0, q, out);
+    Unique(out);
+}
+
+// Same separating-axis test as SegmentIntersectsBox (Geometry.h)
+template <class Coord, int FanOut>
+bool BasicQuadtree<Coord, FanOut>::SegmentHitsBox(Coord xs, Coord ys, Coord xe, Coord ye, const Box& b) {
+    if (max(xs, xe) < b.x1 || min(xs, xe) > b.x2 || max(ys, ye) < b.y1 || min(ys, ye) > b.y2)
+        return false;
+    Wide dx = (Wide)xe - xs, dy = (Wide)ye - ys;
+    Wide a1 = dx * ((Wide)b.y1 - ys), a2 = dx * ((Wide)b.y2 - ys);
+    Wide b1 = dy * ((Wide)b.x1 - xs), b2 = dy * ((Wide)b.x2 - xs);
+    Wide c1 = a1 - b1, c2 = a2 - b1, c3 = a1 - b2, c4 = a2 - b2;
+    bool allAbove = c1 > 0 && c2 > 0 && c3 > 0 && c4 > 0;
+    bool allBelow = c1 < 0 && c2 < 0 && c3 < 0 && c4 < 0;
+    return !allAbove && !allBelow;
+}
+
+template <class Coord, int FanOut>
+void BasicQuadtree<Coord, FanOut>::CollectNet(int n, Coord xs, Coord ys, Coord xe, Coord ye, vector<int>& out) const {
+    const Node& node = nodes[n];
+    if (!SegmentHitsBox(xs, ys, xe, ye, node.box)) return;
+    if (node.firstChild < 0) {
+        for (int k = node.partBegin; k < node.partEnd; ++k)
+            if (SegmentHitsBox(xs, ys, xe, ye, boxes[pool[k]])) out.push_back(pool[k]);
+        return;
+    }
+    for (int c = node.firstChild; c < node.firstChild + node.cols * node.rows; ++c)
+        CollectNet(c, xs, ys, xe, ye, out);
+}
+
+template <class Coord, int FanOut>
+void BasicQuadtree<Coord, FanOut>::NetIntersect(Coord x1, Coord y1, Coord x2, Coord y2, vector<int>& out) const {
+    out.clear();
+    CollectNet(0, x1, y1, x2, y2, out);
+    Unique(out);
+}
+
+#endif
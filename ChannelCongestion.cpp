@@ -0,0 +1,365 @@
+#include "ChannelCongestion.h"
+#include "Geometry.h"
+#include <algorithm>
+#include <thread>
+
+// ================= Setup ====================================
+
+static bool StrictOverlap(const Rect& a, const Rect& b) {
+    return max(a.x1, b.x1) < min(a.x2, b.x2) && max(a.y1, b.y1) < min(a.y2, b.y2);
+}
+
+static bool Encloses(const Rect& outer, const Rect& inner) {
+    return outer.x1 <= inner.x1 && inner.x2 <= outer.x2 && outer.y1 <= inner.y1 && inner.y2 <= outer.y2;
+}
+
+// Length of the border a and b share (0 when they only meet at a corner)
+static int SharedBorder(const Rect& a, const Rect& b) {
+    if (a.x2 == b.x1 || b.x2 == a.x1) return max(min(a.y2, b.y2) - max(a.y1, b.y1), 0);
+    if (a.y2 == b.y1 || b.y2 == a.y1) return max(min(a.x2, b.x2) - max(a.x1, b.x1), 0);
+    return 0;
+}
+
+void ChannelCongestion::Attach(const QuadtreeNode& t, const CompactChannelGraph& graph, int trackPitch) {
+    tree = &t;
+    pitch = max(trackPitch, 1);
+
+    // Partitions: fresh geometric capacities, usage carried over by vertex index
+    size_t n = graph.NumPartitions();
+    vector<atomic<int>> usage(n), capacity(n);
+    boxes.resize(n);
+    for (size_t v = 0; v < n; ++v) {
+        Rect& b = boxes[v];
+        b = {graph.X1(v), graph.Y1(v), graph.X2(v), graph.Y2(v)};
+        int side = b.x1 < b.x2 && b.y1 < b.y2 ? min(b.x2 - b.x1, b.y2 - b.y1) : 0;
+        usage[v].store(v < partUsage.size() ? partUsage[v].load(memory_order_relaxed) : 0, memory_order_relaxed);
+        capacity[v].store(max(side / pitch, 1), memory_order_relaxed);
+    }
+    partUsage = move(usage);
+    partCapacity = move(capacity);
+
+    // Edges: each undirected CSR edge once, in key order; usage carried over by endpoints
+    vector<uint64_t> keys;
+    for (size_t v = 0; v < n; ++v)
+        for (const int* u = graph.NeighborsBegin(v); u != graph.NeighborsEnd(v); ++u)
+            if (*u > (int)v) keys.push_back(EdgeKey((int)v, *u));
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+    vector<atomic<int>> eUsage(keys.size()), eCapacity(keys.size());
+    for (size_t e = 0; e < keys.size(); ++e) {
+        int a = (int)(keys[e] >> 32), b = (int)(uint32_t)keys[e];
+        auto old = lower_bound(edgeKeys.begin(), edgeKeys.end(), keys[e]);
+        int carried = old != edgeKeys.end() && *old == keys[e] ? edgeUsage[old - edgeKeys.begin()].load(memory_order_relaxed) : 0;
+        eUsage[e].store(carried, memory_order_relaxed);
+        eCapacity[e].store(max(SharedBorder(boxes[a], boxes[b]) / pitch, 1), memory_order_relaxed);
+    }
+    edgeKeys.swap(keys);
+    edgeUsage = move(eUsage);
+    edgeCapacity = move(eCapacity);
+
+    // Node regions, breadth first so children are contiguous and follow their parent
+    vector<const QuadtreeNode*> order(1, &t);
+    nodes.assign(1, Node());
+    nodes[0].parent = -1;
+    for (size_t i = 0; i < order.size(); ++i) {
+        const Vertex& r = order[i]->getRegion();
+        nodes[i].box = {r.x, r.y, r.x + r.width, r.y + r.height};
+        nodes[i].firstChild = (int)order.size();
+        nodes[i].childCount = (int)order[i]->GetChildren().size();
+        for (const QuadtreeNode* ch : order[i]->GetChildren()) {
+            order.push_back(ch);
+            Node child = Node();
+            child.parent = (int)i;
+            nodes.push_back(child);
+        }
+    }
+
+    // Owners, then each node's owned partitions as one slice of owned[]
+    owner.resize(n);
+    vector<int> ownCount(nodes.size() + 1, 0);
+    for (size_t v = 0; v < n; ++v) {
+        owner[v] = OwnerOf(boxes[v]);
+        if (owner[v] >= 0) ++ownCount[owner[v] + 1];
+    }
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        ownCount[i + 1] += ownCount[i];
+        nodes[i].ownBegin = nodes[i].ownEnd = ownCount[i];
+    }
+    owned.resize(ownCount[nodes.size()]);
+    for (size_t v = 0; v < n; ++v)
+        if (owner[v] >= 0) owned[nodes[owner[v]].ownEnd++] = (int)v;
+    for (size_t i = nodes.size(); i-- > 0;) {
+        nodes[i].partitions += nodes[i].ownEnd - nodes[i].ownBegin;
+        if (nodes[i].parent >= 0) nodes[nodes[i].parent].partitions += nodes[i].partitions;
+    }
+
+    nodeUsage = vector<atomic<long long>>(nodes.size());
+    nodeCapacity = vector<atomic<long long>>(nodes.size());
+    nodeOverflow = vector<atomic<long long>>(nodes.size());
+    nodePeak = vector<atomic<double>>(nodes.size());
+    RefreshPeaks();
+}
+
+// Smallest node whose closed region holds the box; -1 for empty (or removed)
+// boxes and boxes outside the root. Boxes reaching out of the root stay at the root.
+int ChannelCongestion::OwnerOf(const Rect& box) const {
+    if (box.x1 >= box.x2 || box.y1 >= box.y2 || !StrictOverlap(box, nodes[0].box)) return -1;
+    int n = 0;
+    for (bool descended = true; descended;) {
+        descended = false;
+        for (int c = nodes[n].firstChild; c < nodes[n].firstChild + nodes[n].childCount; ++c) {
+            if (Encloses(nodes[c].box, box)) {
+                n = c;
+                descended = true;
+                break;
+            }
+        }
+    }
+    return n;
+}
+
+void ChannelCongestion::RefreshPeaks() {
+    vector<long long> usage(nodes.size(), 0), capacity(nodes.size(), 0), overflow(nodes.size(), 0);
+    vector<double> peak(nodes.size(), 0.0);
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        for (int k = nodes[n].ownBegin; k < nodes[n].ownEnd; ++k) {
+            int u = Usage(owned[k]), c = Capacity(owned[k]);
+            usage[n] += u;
+            capacity[n] += c;
+            overflow[n] += max(u - c, 0);
+            peak[n] = max(peak[n], Ratio(u, c));
+        }
+    }
+    for (size_t n = nodes.size(); n-- > 0;) {
+        int p = nodes[n].parent;
+        if (p >= 0) {
+            usage[p] += usage[n];
+            capacity[p] += capacity[n];
+            overflow[p] += overflow[n];
+            peak[p] = max(peak[p], peak[n]);
+        }
+        nodeUsage[n].store(usage[n], memory_order_relaxed);
+        nodeCapacity[n].store(capacity[n], memory_order_relaxed);
+        nodeOverflow[n].store(overflow[n], memory_order_relaxed);
+        nodePeak[n].store(peak[n], memory_order_relaxed);
+    }
+}
+
+void ChannelCongestion::ClearUsage() {
+    for (auto& u : partUsage) u.store(0, memory_order_relaxed);
+    for (auto& u : edgeUsage) u.store(0, memory_order_relaxed);
+    RefreshPeaks();
+}
+
+// ================= Counters =================================
+
+int ChannelCongestion::EdgeID(int a, int b) const {
+    uint64_t key = EdgeKey(a, b);
+    auto it = lower_bound(edgeKeys.begin(), edgeKeys.end(), key);
+    return it != edgeKeys.end() && *it == key ? (int)(it - edgeKeys.begin()) : -1;
+}
+
+int ChannelCongestion::EdgeUsage(int a, int b) const {
+    int e = EdgeID(a, b);
+    return e >= 0 ? edgeUsage[e].load(memory_order_relaxed) : 0;
+}
+
+int ChannelCongestion::EdgeCapacity(int a, int b) const {
+    int e = EdgeID(a, b);
+    return e >= 0 ? edgeCapacity[e].load(memory_order_relaxed) : 0;
+}
+
+// Bounds only ever grow here; once a node already covers ratio its ancestors do too
+void ChannelCongestion::RaisePeak(int n, double ratio) {
+    for (; n >= 0; n = nodes[n].parent) {
+        double current = nodePeak[n].load(memory_order_relaxed);
+        if (current >= ratio) break;
+        while (current < ratio && !nodePeak[n].compare_exchange_weak(current, ratio, memory_order_relaxed)) {}
+    }
+}
+
+void ChannelCongestion::AddUsage(int pid, int amount) {
+    if (pid < 0 || pid >= (int)partUsage.size() || !amount) return;
+    int before = partUsage[pid].fetch_add(amount, memory_order_relaxed);
+    int after = before + amount;
+    int capacity = Capacity(pid);
+    long long overflow = (long long)max(after - capacity, 0) - max(before - capacity, 0);
+    for (int n = owner[pid]; n >= 0; n = nodes[n].parent) {
+        nodeUsage[n].fetch_add(amount, memory_order_relaxed);
+        if (overflow) nodeOverflow[n].fetch_add(overflow, memory_order_relaxed);
+    }
+    if (amount > 0 && owner[pid] >= 0) RaisePeak(owner[pid], Ratio(after, capacity));
+}
+
+bool ChannelCongestion::AddEdgeUsage(int a, int b, int amount) {
+    int e = EdgeID(a, b);
+    if (e < 0) return false;
+    edgeUsage[e].fetch_add(amount, memory_order_relaxed);
+    return true;
+}
+
+void ChannelCongestion::SetCapacity(int pid, int capacity) {
+    if (pid < 0 || pid >= (int)partCapacity.size()) return;
+    capacity = max(capacity, 0);
+    int before = partCapacity[pid].exchange(capacity, memory_order_relaxed);
+    int usage = Usage(pid);
+    long long overflow = (long long)max(usage - capacity, 0) - max(usage - before, 0);
+    for (int n = owner[pid]; n >= 0; n = nodes[n].parent) {
+        nodeCapacity[n].fetch_add(capacity - before, memory_order_relaxed);
+        nodeOverflow[n].fetch_add(overflow, memory_order_relaxed);
+    }
+    if (owner[pid] >= 0) RaisePeak(owner[pid], Ratio(usage, capacity));
+}
+
+bool ChannelCongestion::SetEdgeCapacity(int a, int b, int capacity) {
+    int e = EdgeID(a, b);
+    if (e < 0) return false;
+    edgeCapacity[e].store(max(capacity, 0), memory_order_relaxed);
+    return true;
+}
+
+// ================= Commits ==================================
+
+// Charges parts (in net order) and the edges between consecutive distinct ones
+void ChannelCongestion::ChargeSequence(const vector<int>& parts, int amount, PathQueryResult* used) {
+    if (used) {
+        used->partitions.clear();
+        used->edges.clear();
+    }
+    int prev = -1;
+    for (int pid : parts) {
+        if (pid < 0 || pid >= (int)partUsage.size() || pid == prev) continue;
+        AddUsage(pid, amount);
+        if (used) used->partitions.push_back(pid);
+        if (prev >= 0 && AddEdgeUsage(prev, pid, amount) && used) used->edges.emplace_back(prev, pid);
+        prev = pid;
+    }
+}
+
+void ChannelCongestion::CommitNet(const QuadtreeNode& t, int x1, int y1, int x2, int y2, int amount,
+                                  PathQueryResult* used) {
+    vector<int> ids;
+    t.NetIntersect(x1, y1, x2, y2, ids);
+
+    // Order along the segment by where it enters each box
+    vector<pair<double, int>> hits;
+    hits.reserve(ids.size());
+    for (int pid : ids) {
+        if (pid < 0 || pid >= (int)boxes.size()) continue;
+        const Rect& b = boxes[pid];
+        hits.emplace_back(SegmentBoxEntry(x1, y1, x2, y2, b.x1, b.y1, b.x2, b.y2), pid);
+    }
+    sort(hits.begin(), hits.end());
+    ids.clear();
+    for (const auto& h : hits) ids.push_back(h.second);
+    ChargeSequence(ids, amount, used);
+}
+
+void ChannelCongestion::CommitPath(const QuadtreeNode& t, const vector<pair<Point, Point>>& path, int amount,
+                                   PathQueryResult* used) {
+    PathQueryResult crossed;
+    t.PathQuery(path, crossed);
+    ChargeSequence(crossed.partitions, amount, used);
+}
+
+void ChannelCongestion::CommitRoute(const ChannelRoute& route, int amount, PathQueryResult* used) {
+    ChargeSequence(route.found ? route.partitions : vector<int>(), amount, used);
+}
+
+void ChannelCongestion::CommitNetBatch(const QuadtreeNode& t, const vector<Segment>& segs, int threads, int amount) {
+    if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+    if (threads <= 0) threads = 1;
+
+    // Workers pull segments from a shared index; the counters take concurrent adds
+    atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < segs.size(); i = next++)
+            CommitNet(t, segs[i].start.x, segs[i].start.y, segs[i].end.x, segs[i].end.y, amount);
+    };
+    vector<std::thread> pool;
+    for (int k = 1; k < threads; ++k) pool.emplace_back(worker);
+    worker();
+    for (auto& th : pool) th.join();
+}
+
+// ================= Aggregates ===============================
+
+void ChannelCongestion::AddOwned(int pid, CongestionSummary& sum) const {
+    int u = Usage(pid), c = Capacity(pid);
+    ++sum.partitions;
+    sum.usage += u;
+    sum.capacity += c;
+    sum.overflow += max(u - c, 0);
+    double ratio = Ratio(u, c);
+    if (ratio > sum.peak || sum.peakPartition < 0) {
+        sum.peak = ratio;
+        sum.peakPartition = pid;
+    }
+}
+
+// Exact peak of n's subtree, skipping subtrees whose bound cannot beat sum.peak
+void ChannelCongestion::PeakNode(int n, CongestionSummary& sum) const {
+    const Node& node = nodes[n];
+    for (int k = node.ownBegin; k < node.ownEnd; ++k) {
+        double ratio = Ratio(Usage(owned[k]), Capacity(owned[k]));
+        if (ratio > sum.peak || sum.peakPartition < 0) {
+            sum.peak = ratio;
+            sum.peakPartition = owned[k];
+        }
+    }
+    for (int c = node.firstChild; c < node.firstChild + node.childCount; ++c)
+        if (nodes[c].partitions && (sum.peakPartition < 0 || nodePeak[c].load(memory_order_relaxed) > sum.peak))
+            PeakNode(c, sum);
+}
+
+void ChannelCongestion::WindowNode(int n, const Rect& q, CongestionSummary& sum) const {
+    const Node& node = nodes[n];
+    bool overlaps = StrictOverlap(node.box, q);
+    if (!overlaps && n != 0) return;  // The root may own partitions reaching out of it
+    if (Encloses(q, node.box)) {
+        // Every partition owned in the subtree lies inside the window
+        sum.partitions += node.partitions;
+        sum.usage += nodeUsage[n].load(memory_order_relaxed);
+        sum.capacity += nodeCapacity[n].load(memory_order_relaxed);
+        sum.overflow += nodeOverflow[n].load(memory_order_relaxed);
+        if (node.partitions && (sum.peakPartition < 0 || nodePeak[n].load(memory_order_relaxed) > sum.peak))
+            PeakNode(n, sum);
+        return;
+    }
+    for (int k = node.ownBegin; k < node.ownEnd; ++k)
+        if (StrictOverlap(boxes[owned[k]], q)) AddOwned(owned[k], sum);
+    if (!overlaps) return;
+    for (int c = node.firstChild; c < node.firstChild + node.childCount; ++c)
+        if (nodes[c].partitions) WindowNode(c, q, sum);
+}
+
+CongestionSummary ChannelCongestion::Window(int x1, int y1, int x2, int y2) const {
+    CongestionSummary sum;
+    if (nodes.empty()) return sum;
+    Rect q = {min(x1, x2), min(y1, y2), max(x1, x2), max(y1, y2)};
+    WindowNode(0, q, sum);
+    return sum;
+}
+
+CongestionSummary ChannelCongestion::Total() const {
+    CongestionSummary sum;
+    if (nodes.empty()) return sum;
+    sum.partitions = nodes[0].partitions;
+    sum.usage = nodeUsage[0].load(memory_order_relaxed);
+    sum.capacity = nodeCapacity[0].load(memory_order_relaxed);
+    sum.overflow = nodeOverflow[0].load(memory_order_relaxed);
+    if (sum.partitions) PeakNode(0, sum);
+    return sum;
+}
+
+void ChannelCongestion::Penalties(vector<double>& out) const {
+    out.resize(partUsage.size());
+    for (size_t v = 0; v < out.size(); ++v) out[v] = max(Ratio(Usage((int)v), Capacity((int)v)), 0.0);
+}
+
+vector<pair<int, int>> ChannelCongestion::OverflowEdges() const {
+    vector<pair<int, int>> out;
+    for (size_t e = 0; e < edgeKeys.size(); ++e)
+        if (edgeUsage[e].load(memory_order_relaxed) > edgeCapacity[e].load(memory_order_relaxed))
+            out.emplace_back((int)(edgeKeys[e] >> 32), (int)(uint32_t)edgeKeys[e]);
+    return out;
+}
@@ -0,0 +1,140 @@
+#ifndef CHANNEL_CONGESTION_H
+#define CHANNEL_CONGESTION_H
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "Quadtree.h"
+#include "CompactChannelGraph.h"
+#include "ChannelRouter.h"
+
+using namespace std;
+
+// Aggregate over the partitions overlapping a window (the same ones RectQuery reports)
+struct CongestionSummary {
+    int partitions = 0;
+    long long usage = 0;       // Tracks committed through them
+    long long capacity = 0;    // Tracks they can hold
+    long long overflow = 0;    // Sum of usage above capacity
+    double peak = 0;           // Highest usage / capacity among them
+    int peakPartition = -1;    // Partition with that ratio (-1 if none)
+};
+
+// Counts routing tracks (capacity and usage) per channel partition and per
+// channel edge, with per-node summaries over the quadtree so window totals and
+// peaks do not visit every partition.
+//
+// Attach copies the tree's node regions and assigns each partition to the
+// smallest node whose region encloses its box. Every node keeps the usage,
+// capacity and overflow sums of the partitions owned in its subtree, plus an
+// upper bound of their peak ratio. A window query takes the sums of nodes it
+// covers whole, tests only the partitions owned by nodes on its border, and
+// descends into covered nodes only while their peak bound can beat the best
+// ratio found so far.
+//
+// Commits update the counters with atomic adds, so nets can be committed from
+// many threads while others query. Rip-ups lower the sums at once but leave
+// peak bounds high (queries stay exact, only slower); RefreshPeaks tightens
+// them. Attach and the capacity setters must not run concurrently with commits.
+class ChannelCongestion {
+public:
+    ChannelCongestion() = default;
+    ChannelCongestion(const ChannelCongestion&) = delete;
+    ChannelCongestion& operator=(const ChannelCongestion&) = delete;
+
+    // Copies the node regions of tree (a root) and the boxes and edges of graph
+    // (vertex indices as in the tree). Capacities come from the geometry: a
+    // partition holds min(width, height) / pitch tracks and an edge its shared
+    // border length / pitch, at least 1 each. Usage of partitions and edges that
+    // still exist is kept, so attach again after partition edits or rebuilds.
+    void Attach(const QuadtreeNode& tree, const CompactChannelGraph& graph, int pitch = 1);
+    const QuadtreeNode* Tree() const { return tree; }
+    size_t NumPartitions() const { return boxes.size(); }
+    size_t NumEdges() const { return edgeKeys.size(); }
+
+    // Overrides the geometric capacity (until the next Attach)
+    void SetCapacity(int pid, int capacity);
+    bool SetEdgeCapacity(int a, int b, int capacity);  // false if a-b is not an edge
+
+    // Adds amount tracks (negative rips them up) to one partition or edge
+    void AddUsage(int pid, int amount);
+    bool AddEdgeUsage(int a, int b, int amount);
+
+    // Commits a net: every partition it crosses and every channel edge between
+    // consecutive partitions along it gets amount tracks. used (optional)
+    // receives the partitions and edges charged, in net order.
+    // CommitNet finds the partitions with tree.NetIntersect, CommitPath with
+    // tree.PathQuery, CommitRoute takes them from a router result.
+    void CommitNet(const QuadtreeNode& tree, int x1, int y1, int x2, int y2, int amount = 1,
+                   PathQueryResult* used = nullptr);
+    void CommitPath(const QuadtreeNode& tree, const vector<pair<Point, Point>>& path, int amount = 1,
+                    PathQueryResult* used = nullptr);
+    void CommitRoute(const ChannelRoute& route, int amount = 1, PathQueryResult* used = nullptr);
+
+    // CommitNet for many segments on worker threads. threads <= 0 uses the hardware concurrency.
+    void CommitNetBatch(const QuadtreeNode& tree, const vector<Segment>& segs, int threads = 0, int amount = 1);
+
+    int Usage(int pid) const { return partUsage[pid].load(memory_order_relaxed); }
+    int Capacity(int pid) const { return partCapacity[pid].load(memory_order_relaxed); }
+    int EdgeUsage(int a, int b) const;     // 0 if a-b is not an edge
+    int EdgeCapacity(int a, int b) const;  // 0 if a-b is not an edge
+
+    // usage / capacity (capacity 0 counts as 1)
+    static double Ratio(long long usage, long long capacity) {
+        return capacity > 0 ? (double)usage / capacity : (double)usage;
+    }
+
+    // Totals and peak over the partitions strictly overlapping the window
+    CongestionSummary Window(int x1, int y1, int x2, int y2) const;
+    CongestionSummary Total() const;  // Every partition inside the tree
+
+    // Per-partition penalties (usage / capacity) for ChannelRouter::SetCongestion
+    void Penalties(vector<double>& out) const;
+
+    // Edges whose usage exceeds their capacity, as (a, b) with a < b
+    vector<pair<int, int>> OverflowEdges() const;
+
+    // Recomputes every node summary from the counters, which makes the peak
+    // bounds exact again (after rip-ups or capacity increases)
+    void RefreshPeaks();
+
+    // Zeroes every usage counter (capacities stay)
+    void ClearUsage();
+
+private:
+    struct Node {
+        Rect box;            // Closed region
+        int parent;
+        int firstChild, childCount;  // Children are contiguous
+        int ownBegin, ownEnd;        // Owned partitions in owned[]
+        int partitions;      // Owned in the subtree
+    };
+
+    const QuadtreeNode* tree = nullptr;
+    int pitch = 1;
+    vector<Rect> boxes;                   // Partition boxes
+    vector<atomic<int>> partUsage, partCapacity;
+    vector<int> owner;                    // Node owning each partition (-1: outside the root or empty)
+    vector<uint64_t> edgeKeys;            // Sorted a << 32 | b with a < b; index is the edge ID
+    vector<atomic<int>> edgeUsage, edgeCapacity;
+
+    vector<Node> nodes;                   // Breadth-first, root at 0
+    vector<int> owned;
+    vector<atomic<long long>> nodeUsage, nodeCapacity, nodeOverflow;  // Subtree sums
+    vector<atomic<double>> nodePeak;      // Upper bound of the subtree's highest ratio
+
+    static uint64_t EdgeKey(int a, int b) {
+        if (a > b) swap(a, b);
+        return (uint64_t)(uint32_t)a << 32 | (uint32_t)b;
+    }
+    int EdgeID(int a, int b) const;
+    int OwnerOf(const Rect& box) const;
+    void RaisePeak(int node, double ratio);  // Lifts the bounds from node up to the root
+    void ChargeSequence(const vector<int>& parts, int amount, PathQueryResult* used);
+    void AddOwned(int pid, CongestionSummary& sum) const;
+    void WindowNode(int n, const Rect& q, CongestionSummary& sum) const;
+    void PeakNode(int n, CongestionSummary& sum) const;
+};
+
+#endif
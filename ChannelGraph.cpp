@@ -1,4 +1,7 @@
 #include "ChannelGraph.h"
+#include <algorithm>
+#include <unordered_map>
+#include <tuple>
 
 // Function to check if two partitions are horizontally touching
 // Conditions:
@@ -9,8 +12,82 @@ bool isHorizontallyTouching(const Partition& a, const Partition& b) {
     return (a.x2 == b.x1 || a.x1 == b.x2) && verticalOverlap; // checks if horizontally adjacent
 }
 
+// Function to check if two partitions are vertically touching
+// Conditions:
+// - They must be adjacent vertically
+// - They must overlap horizontally (i.e., share some x-range)
+bool isVerticallyTouching(const Partition& a, const Partition& b) {
+    bool horizontalOverlap = max(a.x1, b.x1) < min(a.x2, b.x2); // checks if X ranges overlap
+    return (a.y2 == b.y1 || a.y1 == b.y2) && horizontalOverlap; // checks if vertically adjacent
+}
+
+// Interval join for one shared edge coordinate: pairs every partition in
+// `before` (edge ends here) with every partition in `after` (edge starts here)
+// whose spans [lo, hi) overlap. Both lists are swept in order of span start
+// while keeping only the spans that are still open.
+static void joinSpans(const vector<Partition>& partitions, const vector<size_t>& before,
+                      const vector<size_t>& after, bool spanIsX, vector<pair<size_t, size_t>>& out) {
+    auto lo = [&](size_t i) { return spanIsX ? partitions[i].x1 : partitions[i].y1; };
+    auto hi = [&](size_t i) { return spanIsX ? partitions[i].x2 : partitions[i].y2; };
+
+    // Events: (span start, side, partition); empty spans can never overlap
+    vector<tuple<int, int, size_t>> events;
+    for (size_t i : before) if (lo(i) < hi(i)) events.emplace_back(lo(i), 0, i);
+    for (size_t i : after)  if (lo(i) < hi(i)) events.emplace_back(lo(i), 1, i);
+    sort(events.begin(), events.end());
+
+    vector<size_t> open[2];
+    for (const auto& ev : events) {
+        int start = get<0>(ev);
+        int side = get<1>(ev);
+        size_t i = get<2>(ev);
+        // Spans of the other side that ended at or before this start are done
+        auto& other = open[1 - side];
+        other.erase(remove_if(other.begin(), other.end(), [&](size_t j) { return hi(j) <= start; }),
+                    other.end());
+        for (size_t j : other) {
+            if (i != j) out.emplace_back(min(i, j), max(i, j));
+        }
+        open[side].push_back(i);
+    }
+}
+
+// Buckets partitions by the coordinate of their low and high edges on one axis
+// and joins each coordinate shared by a high edge and a low edge
+static void sweepAxis(const vector<Partition>& partitions, bool alongX, vector<pair<size_t, size_t>>& out) {
+    unordered_map<int, vector<size_t>> highEdges, lowEdges;
+    for (size_t i = 0; i < partitions.size(); ++i) {
+        const Partition& p = partitions[i];
+        highEdges[alongX ? p.x2 : p.y2].push_back(i);
+        lowEdges[alongX ? p.x1 : p.y1].push_back(i);
+    }
+    for (const auto& bucket : highEdges) {
+        auto match = lowEdges.find(bucket.first);
+        if (match == lowEdges.end()) continue;
+        // Touching along X means the spans to compare are the Y ranges, and vice versa
+        joinSpans(partitions, bucket.second, match->second, !alongX, out);
+    }
+    // A pair can be found from both sides; sorted order also matches the
+    // (i, j) order the all-pairs loop used to add edges in
+    sort(out.begin(), out.end());
+    out.erase(unique(out.begin(), out.end()), out.end());
+}
+
+ChannelAdjacency findTouchingPartitions(const vector<Partition>& partitions) {
+    ChannelAdjacency adjacency;
+    sweepAxis(partitions, true, adjacency.horizontal);
+    sweepAxis(partitions, false, adjacency.vertical);
+    return adjacency;
+}
+
 // Function to construct the channel graph
 void makeChannelGraph(ChannelGraph& graph, const vector<Partition>& partitions) {
+    vector<pair<size_t, size_t>> verticalEdges;
+    makeChannelGraph(graph, partitions, verticalEdges);
+}
+
+void makeChannelGraph(ChannelGraph& graph, const vector<Partition>& partitions,
+                      vector<pair<size_t, size_t>>& verticalEdges) {
     graph.clear(); // Clear any existing graph structure
 
     // Add all partitions as vertices to the graph
@@ -19,12 +96,9 @@ void makeChannelGraph(ChannelGraph& graph, const vector<Partition>& partitions)
     }
 
     // Connect partitions that are horizontally touching
-    size_t n = partitions.size();
-    for (size_t i = 0; i < n; ++i) {
-        for (size_t j = i + 1; j < n; ++j) {
-            if (isHorizontallyTouching(partitions[i], partitions[j])) {
-                boost::add_edge(i, j, graph); // Add undirected edge
-            }
-        }
+    ChannelAdjacency adjacency = findTouchingPartitions(partitions);
+    for (const auto& e : adjacency.horizontal) {
+        boost::add_edge(e.first, e.second, graph); // Add undirected edge
     }
+    verticalEdges = std::move(adjacency.vertical);
 }
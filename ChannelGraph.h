@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include <utility>
 #include <boost/graph/adjacency_list.hpp>
 
 using namespace std;
@@ -18,10 +19,27 @@ struct Partition {
 // Each node in the graph is a Partition, and edges are undirected.
 typedef boost::adjacency_list<boost::vecS, boost::vecS, boost::undirectedS, Partition> ChannelGraph;
 
+// Touching partition pairs (i < j, indices into the partition list), sorted
+struct ChannelAdjacency {
+    vector<pair<size_t, size_t>> horizontal; // Side by side, overlapping in Y
+    vector<pair<size_t, size_t>> vertical;   // Stacked, overlapping in X
+};
+
 //  To check if two partitions touch horizontally (i.e., side-by-side and overlapping in Y)
 bool isHorizontallyTouching(const Partition& a, const Partition& b);
 
+//  To check if two partitions touch vertically (i.e., stacked and overlapping in X)
+bool isVerticallyTouching(const Partition& a, const Partition& b);
+
+// Finds both adjacencies in one pass by bucketing partitions on their edge
+// coordinates and sweeping each shared coordinate, instead of testing all pairs.
+ChannelAdjacency findTouchingPartitions(const vector<Partition>& partitions);
+
 // Function to construct the channel graph by connecting horizontally touching partitions.
 void makeChannelGraph(ChannelGraph& graph, const vector<Partition>& partitions);
 
+// Same graph, also returning the vertically touching pairs found in the same pass.
+void makeChannelGraph(ChannelGraph& graph, const vector<Partition>& partitions,
+                      vector<pair<size_t, size_t>>& verticalEdges);
+
 #endif
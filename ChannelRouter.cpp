@@ -0,0 +1,114 @@
+#include "ChannelRouter.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <thread>
+
+// ================= Setup ====================================
+
+ChannelRouter::ChannelRouter(const CompactChannelGraph& g)
+    : graph(g), congestion(nullptr), epoch(0) {
+    size_t n = graph.NumPartitions();
+    centerX.resize(n);
+    centerY.resize(n);
+    for (size_t v = 0; v < n; ++v) {
+        centerX[v] = (graph.X1(v) + graph.X2(v)) / 2.0;
+        centerY[v] = (graph.Y1(v) + graph.Y2(v)) / 2.0;
+    }
+    gScore.resize(n);
+    cameFrom.resize(n);
+    seenStamp.assign(n, 0);
+    closedStamp.assign(n, 0);
+    heap.reserve(n);
+}
+
+double ChannelRouter::Distance(int a, int b) const {
+    return std::hypot(centerX[a] - centerX[b], centerY[a] - centerY[b]);
+}
+
+// Invalidates the previous search's state without touching every entry
+void ChannelRouter::NextEpoch() {
+    if (++epoch == 0) {
+        fill(seenStamp.begin(), seenStamp.end(), 0);
+        fill(closedStamp.begin(), closedStamp.end(), 0);
+        epoch = 1;
+    }
+    heap.clear();
+}
+
+// ================= A* Search ================================
+
+bool ChannelRouter::Route(int source, int target, ChannelRoute& route) {
+    route.found = false;
+    route.cost = 0;
+    route.partitions.clear();
+    int n = (int)graph.NumPartitions();
+    if (source < 0 || target < 0 || source >= n || target >= n) return false;
+
+    NextEpoch();
+    auto greater = std::greater<pair<double, int>>();
+    gScore[source] = 0;
+    cameFrom[source] = -1;
+    seenStamp[source] = epoch;
+    heap.emplace_back(Distance(source, target), source);
+
+    while (!heap.empty()) {
+        pop_heap(heap.begin(), heap.end(), greater);
+        int v = heap.back().second;
+        heap.pop_back();
+        if (closedStamp[v] == epoch) continue;  // stale heap entry
+        closedStamp[v] = epoch;
+
+        if (v == target) {
+            route.found = true;
+            route.cost = gScore[v];
+            for (int u = v; u != -1; u = cameFrom[u]) route.partitions.push_back(u);
+            reverse(route.partitions.begin(), route.partitions.end());
+            return true;
+        }
+
+        for (const int* it = graph.NeighborsBegin(v); it != graph.NeighborsEnd(v); ++it) {
+            int u = *it;
+            if (closedStamp[u] == epoch) continue;
+            double weight = Distance(v, u) * (1.0 + (congestion ? (*congestion)[u] : 0.0));
+            double g = gScore[v] + weight;
+            if (seenStamp[u] != epoch || g < gScore[u]) {
+                seenStamp[u] = epoch;
+                gScore[u] = g;
+                cameFrom[u] = v;
+                heap.emplace_back(g + Distance(u, target), u);
+                push_heap(heap.begin(), heap.end(), greater);
+            }
+        }
+    }
+    return false;
+}
+
+bool ChannelRouter::Route(const QuadtreeNode& tree, Point from, Point to, ChannelRoute& route) {
+    return Route(tree.LocatePartition(from.x, from.y), tree.LocatePartition(to.x, to.y), route);
+}
+
+// ================= Batch Routing ============================
+
+vector<ChannelRoute> RouteBatch(const CompactChannelGraph& graph, const QuadtreeNode& tree,
+                                const vector<pair<Point, Point>>& nets, int threads,
+                                const vector<double>* congestion) {
+    vector<ChannelRoute> routes(nets.size());
+    if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+    if (threads <= 0) threads = 1;
+
+    // Each worker owns a router and pulls nets from a shared index
+    std::atomic<size_t> nextNet(0);
+    auto worker = [&]() {
+        ChannelRouter router(graph);
+        router.SetCongestion(congestion);
+        for (size_t i = nextNet++; i < nets.size(); i = nextNet++)
+            router.Route(tree, nets[i].first, nets[i].second, routes[i]);
+    };
+    vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& th : pool) th.join();
+    return routes;
+}
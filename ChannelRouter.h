@@ -0,0 +1,58 @@
+#ifndef CHANNEL_ROUTER_H
+#define CHANNEL_ROUTER_H
+
+#include <vector>
+#include <utility>
+#include "CompactChannelGraph.h"
+#include "Quadtree.h"
+
+using namespace std;
+
+// One routed connection through the channel graph
+struct ChannelRoute {
+    bool found = false;
+    double cost = 0;            // Sum of edge weights along the route
+    vector<int> partitions;     // Partition IDs from source to target
+};
+
+// A* shortest channel path over a frozen CSR channel graph.
+// Edge weight is the distance between partition centres, scaled by
+// (1 + congestion) of the partition being entered, so the straight-line
+// distance to the target stays an admissible heuristic.
+// All search state is preallocated and reset by epoch stamps, so a router can
+// answer many queries without allocating; use one router per thread.
+class ChannelRouter {
+private:
+    const CompactChannelGraph& graph;
+    const vector<double>* congestion;   // Optional per-partition penalty (>= 0)
+    vector<double> centerX, centerY;    // Partition centres
+    vector<double> gScore;              // Best known cost from the source
+    vector<int> cameFrom;               // Predecessor on the best path
+    vector<unsigned> seenStamp;         // gScore/cameFrom valid when == epoch
+    vector<unsigned> closedStamp;       // Settled when == epoch
+    unsigned epoch;
+    vector<pair<double, int>> heap;     // Open set as a binary min-heap (f, partition)
+
+    double Distance(int a, int b) const;
+    void NextEpoch();
+
+public:
+    explicit ChannelRouter(const CompactChannelGraph& g);
+
+    // Sets (or clears with nullptr) the per-partition congestion penalties
+    void SetCongestion(const vector<double>* penalty) { congestion = penalty; }
+
+    // Routes between two partitions; returns route.found
+    bool Route(int source, int target, ChannelRoute& route);
+
+    // Resolves both points to partitions through the quadtree leaf lookup, then routes
+    bool Route(const QuadtreeNode& tree, Point from, Point to, ChannelRoute& route);
+};
+
+// Routes a whole netlist on worker threads (one router per thread).
+// threads <= 0 uses the hardware concurrency.
+vector<ChannelRoute> RouteBatch(const CompactChannelGraph& graph, const QuadtreeNode& tree,
+                                const vector<pair<Point, Point>>& nets, int threads = 0,
+                                const vector<double>* congestion = nullptr);
+
+#endif
@@ -0,0 +1,59 @@
+#include "CompactChannelGraph.h"
+#include <algorithm>
+
+// Copies vertices into SoA arrays and the name pool, then lays out adjacency
+// by counting degrees, prefix-summing them into offsets and filling neighbors
+void CompactChannelGraph::Build(const ChannelGraph& graph, const vector<pair<size_t, size_t>>& extraEdges) {
+    size_t n = boost::num_vertices(graph);
+    x1.resize(n); y1.resize(n); x2.resize(n); y2.resize(n);
+    namePool.clear();
+    nameOffset.assign(1, 0);
+    for (size_t v = 0; v < n; ++v) {
+        const Partition& p = graph[v];
+        x1[v] = p.x1; y1[v] = p.y1; x2[v] = p.x2; y2[v] = p.y2;
+        namePool += p.name;
+        nameOffset.push_back(namePool.size());
+    }
+
+    vector<pair<int, int>> edges;
+    for (auto e : boost::make_iterator_range(boost::edges(graph)))
+        edges.emplace_back((int)boost::source(e, graph), (int)boost::target(e, graph));
+    for (const auto& e : extraEdges)
+        edges.emplace_back((int)e.first, (int)e.second);
+
+    edgeOffset.assign(n + 1, 0);
+    for (const auto& e : edges) {
+        ++edgeOffset[e.first + 1];
+        ++edgeOffset[e.second + 1];
+    }
+    for (size_t v = 0; v < n; ++v) edgeOffset[v + 1] += edgeOffset[v];
+
+    neighbors.assign(edgeOffset[n], 0);
+    vector<size_t> fill(edgeOffset.begin(), edgeOffset.end() - 1);
+    for (const auto& e : edges) {
+        neighbors[fill[e.first]++] = e.second;
+        neighbors[fill[e.second]++] = e.first;
+    }
+    // Sorted, duplicate-free lists keep HasEdge a binary search
+    vector<size_t> packed(n + 1, 0);
+    size_t out = 0;
+    for (size_t v = 0; v < n; ++v) {
+        auto first = neighbors.begin() + edgeOffset[v], last = neighbors.begin() + edgeOffset[v + 1];
+        sort(first, last);
+        last = unique(first, last);
+        for (auto it = first; it != last; ++it) neighbors[out++] = *it;
+        packed[v + 1] = out;
+    }
+    neighbors.resize(out);
+    neighbors.shrink_to_fit();
+    edgeOffset.swap(packed);
+}
+
+bool CompactChannelGraph::HasEdge(int a, int b) const {
+    return std::binary_search(NeighborsBegin(a), NeighborsEnd(a), b);
+}
+
+size_t CompactChannelGraph::MemoryBytes() const {
+    return (x1.capacity() + y1.capacity() + x2.capacity() + y2.capacity() + neighbors.capacity()) * sizeof(int) +
+           (nameOffset.capacity() + edgeOffset.capacity()) * sizeof(size_t) + namePool.capacity();
+}
@@ -0,0 +1,55 @@
+#ifndef COMPACT_CHANNEL_GRAPH_H
+#define COMPACT_CHANNEL_GRAPH_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include "ChannelGraph.h"
+
+using namespace std;
+
+// Read-only compressed sparse row (CSR) copy of a ChannelGraph, frozen after
+// makeChannelGraph. Coordinates are kept in SoA arrays, names are interned into
+// one string pool and adjacency lives in flat offset/neighbor arrays.
+class CompactChannelGraph {
+private:
+    vector<int> x1, y1, x2, y2;     // Partition boxes, indexed by vertex
+    string namePool;                // All names back to back
+    vector<size_t> nameOffset;      // Name of vertex v is namePool[nameOffset[v] .. nameOffset[v + 1])
+    vector<size_t> edgeOffset;      // Neighbors of v are neighbors[edgeOffset[v] .. edgeOffset[v + 1])
+    vector<int> neighbors;          // Sorted per vertex
+
+public:
+    CompactChannelGraph() = default;
+
+    // Freezes the given graph (vertex indices stay the same)
+    explicit CompactChannelGraph(const ChannelGraph& graph) { Build(graph); }
+
+    // Rebuilds the arrays from graph, plus optional extra undirected edges
+    // (e.g. the vertical pairs from makeChannelGraph)
+    void Build(const ChannelGraph& graph, const vector<pair<size_t, size_t>>& extraEdges = {});
+
+    size_t NumPartitions() const { return x1.size(); }
+    size_t NumEdges() const { return neighbors.size() / 2; }
+
+    int X1(int v) const { return x1[v]; }
+    int Y1(int v) const { return y1[v]; }
+    int X2(int v) const { return x2[v]; }
+    int Y2(int v) const { return y2[v]; }
+
+    // Name of vertex v, copied out of the pool
+    string Name(int v) const { return namePool.substr(nameOffset[v], nameOffset[v + 1] - nameOffset[v]); }
+
+    // Neighbor range of vertex v
+    const int* NeighborsBegin(int v) const { return neighbors.data() + edgeOffset[v]; }
+    const int* NeighborsEnd(int v) const { return neighbors.data() + edgeOffset[v + 1]; }
+    int Degree(int v) const { return (int)(edgeOffset[v + 1] - edgeOffset[v]); }
+
+    // True if a and b are adjacent (binary search in a's neighbor list)
+    bool HasEdge(int a, int b) const;
+
+    // Heap footprint of all arrays
+    size_t MemoryBytes() const;
+};
+
+#endif
@@ -0,0 +1,404 @@
+#include "ConcurrentQuadtree.h"
+#include <stdexcept>
+
+// ================= Thread slots ============================
+
+// Each thread that touches an EpochDomain gets a small index into the reader
+// slot arrays; the index goes back to the pool when the thread exits
+namespace {
+mutex slotPoolMutex;
+vector<int> freeSlots;
+int nextSlot = 0;
+
+struct ThreadSlot {
+    int index;
+    ThreadSlot() {
+        lock_guard<mutex> lock(slotPoolMutex);
+        if (!freeSlots.empty()) {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+        } else if (nextSlot < EpochDomain::MaxThreads) {
+            index = nextSlot++;
+        } else {
+            throw runtime_error("EpochDomain: more than MaxThreads threads");
+        }
+    }
+    ~ThreadSlot() {
+        lock_guard<mutex> lock(slotPoolMutex);
+        freeSlots.push_back(index);
+    }
+};
+
+int CurrentThreadSlot() {
+    static thread_local ThreadSlot slot;
+    return slot.index;
+}
+}
+
+// ================= Epoch domain ============================
+
+EpochDomain::EpochDomain() : globalEpoch(0), slots(new Slot[MaxThreads]) {}
+
+EpochDomain::~EpochDomain() {
+    for (auto& r : retired) r.free();
+}
+
+// A reader that loaded epoch E can only hold objects retired at E or later, so
+// publishing E in its slot (sequentially consistent) keeps those alive
+void EpochDomain::Pin() {
+    slots[CurrentThreadSlot()].epoch.store(globalEpoch.load());
+}
+
+void EpochDomain::Unpin() {
+    slots[CurrentThreadSlot()].epoch.store(Idle);
+}
+
+// The object is already unlinked; readers pinning after the increment can't see it
+void EpochDomain::Retire(function<void()> free) {
+    uint64_t epoch = globalEpoch.fetch_add(1);
+    size_t pending;
+    {
+        lock_guard<mutex> lock(retireMutex);
+        retired.push_back({epoch, std::move(free)});
+        pending = retired.size();
+    }
+    // Scanning every slot costs the same for one object or many, so batch it
+    if (pending >= 64) Reclaim();
+}
+
+size_t EpochDomain::Reclaim() {
+    uint64_t oldestPinned = Idle;
+    for (int i = 0; i < MaxThreads; ++i)
+        oldestPinned = min(oldestPinned, slots[i].epoch.load());
+
+    vector<Retired> ready;
+    {
+        lock_guard<mutex> lock(retireMutex);
+        auto keep = partition(retired.begin(), retired.end(),
+                              [&](const Retired& r) { return r.epoch >= oldestPinned; });
+        ready.assign(std::make_move_iterator(keep), std::make_move_iterator(retired.end()));
+        retired.erase(keep, retired.end());
+    }
+    for (auto& r : ready) r.free();
+    return ready.size();
+}
+
+size_t EpochDomain::PendingCount() const {
+    lock_guard<mutex> lock(retireMutex);
+    return retired.size();
+}
+
+// ================= Version ================================
+
+ConcurrentQuadtree::Version::~Version() {
+    for (size_t i = 0; i < leafCount; ++i) delete blocks[i].load();
+}
+
+bool ConcurrentQuadtree::Version::InNode(int n, int x, int y) const {
+    return x >= nodeX[n] && x <= nodeX[n] + nodeWidth[n] &&
+           y >= nodeY[n] && y <= nodeY[n] + nodeHeight[n];
+}
+
+// Same first-match walk as QuadtreeNode::Descend
+int ConcurrentQuadtree::Version::Descend(int x, int y, PointResult& result) const {
+    if (!InNode(0, x, y)) {
+        result.status = PointStatus::OutsideBoundary;
+        return -1;
+    }
+    int n = 0;
+    result.path.push_back(nodeID[n]);
+    while (childCount[n] > 0) {
+        int next = -1;
+        for (int c = firstChild[n]; c < firstChild[n] + childCount[n]; ++c) {
+            if (InNode(c, x, y)) {
+                next = c;
+                break;
+            }
+        }
+        if (next < 0) break;
+        n = next;
+        result.path.push_back(nodeID[n]);
+    }
+    result.leafID = nodeID[n];
+    result.region = {nodeX[n], nodeY[n], nodeX[n] + nodeWidth[n], nodeY[n] + nodeHeight[n]};
+    result.status = childCount[n] == 0 ? PointStatus::Ok : PointStatus::NoLeaf;
+    return childCount[n] == 0 ? n : -1;
+}
+
+// ================= Publish ================================
+
+ConcurrentQuadtree::ConcurrentQuadtree() : current(nullptr) {}
+
+ConcurrentQuadtree::~ConcurrentQuadtree() {
+    delete current.load();
+}
+
+// Lays the tree out breadth-first so every node's children are contiguous,
+// moves the held points into the new leaves and swaps the version pointer
+void ConcurrentQuadtree::Publish(const QuadtreeNode& tree, const ChannelGraph& graph) {
+    unique_ptr<Version> v(new Version());
+    vector<const QuadtreeNode*> order{&tree};
+    v->parentNode.push_back(-1);
+    for (size_t n = 0; n < order.size(); ++n) {
+        const QuadtreeNode* node = order[n];
+        const Vertex& r = node->getRegion();
+        v->nodeX.push_back(r.x);
+        v->nodeY.push_back(r.y);
+        v->nodeWidth.push_back(r.width);
+        v->nodeHeight.push_back(r.height);
+        v->nodeLevel.push_back(r.level);
+        v->nodeID.push_back(node->GetID());
+        v->firstChild.push_back(node->GetChildren().empty() ? -1 : (int)order.size());
+        v->childCount.push_back((int)node->GetChildren().size());
+        for (auto* ch : node->GetChildren()) {
+            order.push_back(ch);
+            v->parentNode.push_back((int)n);
+        }
+        v->leafSlot.push_back(node->GetChildren().empty() ? (int)v->leafCount++ : -1);
+
+        // Internal nodes hold partitions only in enclosing-index trees
+        const vector<int>& ids = node->GetPartitionIDs();
+        v->partBegin.push_back((int)v->partitionPool.size());
+        v->partitionPool.insert(v->partitionPool.end(), ids.begin(), ids.end());
+        v->partEnd.push_back((int)v->partitionPool.size());
+    }
+    for (auto vertexID : boost::make_iterator_range(vertices(graph))) {
+        const Partition& p = graph[vertexID];
+        v->partitionBox.push_back({p.x1, p.y1, p.x2, p.y2});
+        v->partitionName.push_back(p.name);
+    }
+
+    v->blocks.reset(new atomic<const PointBlock*>[v->leafCount]);
+    v->leafLocks.reset(new mutex[v->leafCount]);
+
+    unique_lock<shared_mutex> lock(publishMutex);
+    Version* old = current.load();
+    vector<vector<pair<int, int>>> moved(v->leafCount);
+    if (old) {
+        for (size_t s = 0; s < old->leafCount; ++s) {
+            const PointBlock* block = old->blocks[s].load();
+            if (!block) continue;
+            ForEachPoint(*block, [&](const pair<int, int>& pt) {
+                PointResult where;
+                int leaf = v->Descend(pt.first, pt.second, where);
+                if (leaf >= 0) moved[v->leafSlot[leaf]].push_back(pt);
+            });
+        }
+    }
+    for (size_t s = 0; s < v->leafCount; ++s) v->blocks[s].store(MakeBlock(moved[s]));
+
+    current.store(v.release());
+    if (old) epochs.Retire([old] { delete old; });
+}
+
+void ConcurrentQuadtree::Unpublish() {
+    unique_lock<shared_mutex> lock(publishMutex);
+    Version* old = current.exchange(nullptr);
+    if (old) epochs.Retire([old] { delete old; });
+}
+
+// ================= Readers =================================
+
+PointResult ConcurrentQuadtree::SearchPoint(int x, int y) const {
+    EpochGuard guard(epochs);
+    PointResult result;
+    const Version* v = current.load();
+    if (!v) return result;
+    int leaf = v->Descend(x, y, result);
+    if (leaf < 0) return result;
+    for (int n = leaf; n >= 0; n = v->parentNode[n]) {
+        for (int k = v->partBegin[n]; k < v->partEnd[n]; ++k) {
+            int pid = v->partitionPool[k];
+            const Rect& p = v->partitionBox[pid];
+            if (x >= p.x1 && x <= p.x2 && y >= p.y1 && y <= p.y2) result.partitions.push_back(pid);
+        }
+    }
+    sort(result.partitions.begin(), result.partitions.end());
+    return result;
+}
+
+// Same pruning and overlap rules as QuadtreeNode::VisitRect, depth-first in child order
+void ConcurrentQuadtree::RectQuery(int x1, int y1, int x2, int y2, vector<int>& out) const {
+    static thread_local QueryScratch scratch;
+    static thread_local vector<int> stack;
+    out.clear();
+    EpochGuard guard(epochs);
+    const Version* v = current.load();
+    if (!v) return;
+
+    if (x1 > x2) swap(x1, x2);
+    if (y1 > y2) swap(y1, y2);
+    scratch.Begin(v->partitionBox.size());
+    stack.assign(1, 0);
+    while (!stack.empty()) {
+        int n = stack.back();
+        stack.pop_back();
+        if (v->nodeX[n] + v->nodeWidth[n] <= x1 || v->nodeX[n] >= x2 ||
+            v->nodeY[n] + v->nodeHeight[n] <= y1 || v->nodeY[n] >= y2)
+            continue;
+        for (int k = v->partBegin[n]; k < v->partEnd[n]; ++k) {
+            int pid = v->partitionPool[k];
+            const Rect& p = v->partitionBox[pid];
+            if (max(x1, p.x1) < min(x2, p.x2) && max(y1, p.y1) < min(y2, p.y2) && scratch.Mark(pid))
+                out.push_back(pid);
+        }
+        for (int c = v->firstChild[n] + v->childCount[n]; c-- > v->firstChild[n];) stack.push_back(c);
+    }
+}
+
+vector<pair<int, int>> ConcurrentQuadtree::PointsInRect(int x1, int y1, int x2, int y2) const {
+    vector<pair<int, int>> found;
+    EpochGuard guard(epochs);
+    const Version* v = current.load();
+    if (!v) return found;
+
+    if (x1 > x2) swap(x1, x2);
+    if (y1 > y2) swap(y1, y2);
+    vector<int> stack{0};
+    while (!stack.empty()) {
+        int n = stack.back();
+        stack.pop_back();
+        if (v->nodeX[n] + v->nodeWidth[n] < x1 || v->nodeX[n] > x2 ||
+            v->nodeY[n] + v->nodeHeight[n] < y1 || v->nodeY[n] > y2)
+            continue;
+        if (v->childCount[n] > 0) {
+            for (int c = v->firstChild[n]; c < v->firstChild[n] + v->childCount[n]; ++c) stack.push_back(c);
+            continue;
+        }
+        const PointBlock* block = v->blocks[v->leafSlot[n]].load();
+        if (!block) continue;
+        ForEachPoint(*block, [&](const pair<int, int>& pt) {
+            if (pt.first >= x1 && pt.first <= x2 && pt.second >= y1 && pt.second <= y2) found.push_back(pt);
+        });
+    }
+    return found;
+}
+
+size_t ConcurrentQuadtree::PointCount() const {
+    EpochGuard guard(epochs);
+    const Version* v = current.load();
+    size_t total = 0;
+    if (!v) return total;
+    for (size_t s = 0; s < v->leafCount; ++s) {
+        const PointBlock* block = v->blocks[s].load();
+        if (block) total += block->count;
+    }
+    return total;
+}
+
+string ConcurrentQuadtree::PartitionName(int pid) const {
+    EpochGuard guard(epochs);
+    const Version* v = current.load();
+    if (!v || pid < 0 || pid >= (int)v->partitionName.size()) return string();
+    return v->partitionName[pid];
+}
+
+// ================= Writers =================================
+
+// Publishes block for a leaf (caller holds its lock) and retires the old one.
+// Chunks it shares with the new block stay alive through their counts.
+void ConcurrentQuadtree::ReplaceBlock(Version& v, int slot, const PointBlock* block) {
+    const PointBlock* old = v.blocks[slot].exchange(block);
+    if (old) epochs.Retire([old] { delete old; });
+}
+
+shared_ptr<ConcurrentQuadtree::PointChunk> ConcurrentQuadtree::NewChunk(size_t capacity, const pair<int, int>* points,
+                                                                        size_t n, shared_ptr<PointChunk> next) {
+    auto chunk = make_shared<PointChunk>();
+    chunk->points.reset(new pair<int, int>[capacity]);
+    chunk->capacity = capacity;
+    chunk->next = std::move(next);
+    copy(points, points + n, chunk->points.get());
+    return chunk;
+}
+
+// Full chunks for all but the first n % ChunkPoints points, which go in the head
+ConcurrentQuadtree::PointBlock* ConcurrentQuadtree::MakeBlock(const vector<pair<int, int>>& points) {
+    if (points.empty()) return nullptr;
+    size_t n = points.size(), headCount = n % ChunkPoints ? n % ChunkPoints : ChunkPoints;
+    shared_ptr<PointChunk> next;
+    for (size_t start = n - ChunkPoints; start >= headCount && start < n; start -= ChunkPoints)
+        next = NewChunk(ChunkPoints, points.data() + start, ChunkPoints, std::move(next));
+    PointBlock* block = new PointBlock();
+    block->head = NewChunk(headCount, points.data(), headCount, std::move(next));
+    block->headCount = headCount;
+    block->count = n;
+    return block;
+}
+
+// The slot past headCount is not visible through any published block (a
+// delete always copies the head), so the point is written there in place
+PointResult ConcurrentQuadtree::InsertPoint(int x, int y) {
+    PointResult result;
+    shared_lock<shared_mutex> lock(publishMutex);
+    Version* v = current.load();
+    if (!v) return result;
+    int leaf = v->Descend(x, y, result);
+    if (leaf < 0) return result;
+
+    int slot = v->leafSlot[leaf];
+    lock_guard<mutex> leafLock(v->leafLocks[slot]);
+    const PointBlock* old = v->blocks[slot].load();
+    PointBlock* updated = new PointBlock();
+    if (!old) {
+        updated->head = NewChunk(4, nullptr, 0, nullptr);
+    } else if (old->headCount < old->head->capacity) {
+        updated->head = old->head;
+        updated->headCount = old->headCount;
+    } else if (old->headCount < ChunkPoints) {
+        updated->head = NewChunk(min(2 * old->headCount, ChunkPoints), old->head->points.get(), old->headCount,
+                                 old->head->next);
+        updated->headCount = old->headCount;
+    } else {
+        updated->head = NewChunk(4, nullptr, 0, old->head);
+    }
+    updated->head->points[updated->headCount++] = make_pair(x, y);
+    updated->count = (old ? old->count : 0) + 1;
+    ReplaceBlock(*v, slot, updated);
+    return result;
+}
+
+PointResult ConcurrentQuadtree::DeletePoint(int x, int y) {
+    PointResult result;
+    shared_lock<shared_mutex> lock(publishMutex);
+    Version* v = current.load();
+    if (!v) return result;
+    int leaf = v->Descend(x, y, result);
+    if (leaf < 0) return result;
+
+    int slot = v->leafSlot[leaf];
+    lock_guard<mutex> leafLock(v->leafLocks[slot]);
+    const PointBlock* old = v->blocks[slot].load();
+    size_t depth = 0, k = 0, n = old ? old->headCount : 0;
+    const PointChunk* holder = old ? old->head.get() : nullptr;
+    for (; holder; holder = holder->next.get(), n = ChunkPoints, ++depth) {
+        k = find(holder->points.get(), holder->points.get() + n, make_pair(x, y)) - holder->points.get();
+        if (k < n) break;
+    }
+    if (!holder) {
+        result.status = PointStatus::NotFound;
+        return result;
+    }
+
+    // Copy the chunks from the head down to the holder; the head's last point fills the hole
+    PointBlock* updated = nullptr;
+    if (old->count > 1) {
+        vector<shared_ptr<PointChunk>> copies;
+        const PointChunk* src = old->head.get();
+        for (size_t i = 0; i <= depth; ++i, src = src->next.get()) {
+            copies.push_back(NewChunk(src->capacity, src->points.get(), i ? ChunkPoints : old->headCount, src->next));
+            if (i) copies[i - 1]->next = copies[i];
+        }
+        copies[depth]->points[k] = copies[0]->points[old->headCount - 1];
+        updated = new PointBlock();
+        updated->head = copies[0];
+        updated->headCount = old->headCount - 1;
+        updated->count = old->count - 1;
+        if (updated->headCount == 0) {
+            updated->head = copies[0]->next;
+            updated->headCount = ChunkPoints;
+        }
+    }
+    ReplaceBlock(*v, slot, updated);
+    return result;
+}
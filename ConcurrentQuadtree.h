@@ -0,0 +1,172 @@
+#ifndef CONCURRENT_QUADTREE_H
+#define CONCURRENT_QUADTREE_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+#include "Quadtree.h"
+#include "ChannelGraph.h"
+
+using namespace std;
+
+// Epoch-based reclamation. Readers pin the current epoch for the duration of a
+// query; writers retire unlinked objects with the epoch they were unlinked in,
+// and an object is freed once every pinned reader started after that epoch.
+// Each thread owns one reader slot (at most MaxThreads threads at a time).
+class EpochDomain {
+public:
+    static const int MaxThreads = 256;
+
+    EpochDomain();
+    ~EpochDomain(); // Frees everything still retired; no readers may be active
+
+    void Pin();     // Enter a read-side critical section (not reentrant)
+    void Unpin();
+
+    // Schedules free() to run once no reader can still see the object
+    void Retire(function<void()> free);
+
+    // Frees retired objects no pinned reader can reach; returns how many
+    size_t Reclaim();
+
+    size_t PendingCount() const;
+
+private:
+    static const uint64_t Idle = ~0ULL;
+    struct alignas(64) Slot {
+        atomic<uint64_t> epoch{Idle};
+    };
+    struct Retired {
+        uint64_t epoch;
+        function<void()> free;
+    };
+    atomic<uint64_t> globalEpoch;
+    unique_ptr<Slot[]> slots;
+    mutable mutex retireMutex;
+    vector<Retired> retired;
+};
+
+// RAII pin for one query
+class EpochGuard {
+public:
+    explicit EpochGuard(EpochDomain& d) : domain(d) { domain.Pin(); }
+    ~EpochGuard() { domain.Unpin(); }
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+private:
+    EpochDomain& domain;
+};
+
+// Read-mostly concurrent quadtree. The spatial skeleton (regions, children,
+// leaf partition lists, partition boxes) is an immutable snapshot of a built
+// QuadtreeNode; each leaf's points live in an immutable block behind an atomic
+// pointer. Readers never lock: they pin an epoch and follow the pointers.
+// Point writers lock only the leaf they change, publish a new block and
+// retire the old one. Publish swaps in a whole new skeleton the same way
+// (RCU), so removed nodes are only freed once no reader can reach them.
+//
+// Write cost: a leaf's points sit in a list of chunks, newest first, each
+// holding at most ChunkPoints and all but the newest full. Blocks share the
+// chunks. An insert writes into the newest chunk past every published count,
+// so it copies nothing unless that chunk has to grow (its capacity doubles up
+// to ChunkPoints). A delete scans the leaf and copies the chunks from the
+// newest down to the one holding the point. Leaves never split here: the
+// tree's point capacity is not applied after Publish, so for dense pin sets
+// insert into the QuadtreeNode (which splits) and publish it again.
+class ConcurrentQuadtree {
+public:
+    static constexpr size_t ChunkPoints = 256;
+
+private:
+    struct PointChunk {
+        unique_ptr<pair<int, int>[]> points;
+        size_t capacity;
+        shared_ptr<PointChunk> next;  // Older chunk, always full
+    };
+    // Readers see the first headCount points of head, then every point of the chunks after it
+    struct PointBlock {
+        shared_ptr<PointChunk> head;
+        size_t headCount = 0;
+        size_t count = 0;             // Points in the whole leaf
+    };
+
+    static shared_ptr<PointChunk> NewChunk(size_t capacity, const pair<int, int>* points, size_t n,
+                                           shared_ptr<PointChunk> next);
+    static PointBlock* MakeBlock(const vector<pair<int, int>>& points);  // nullptr if empty
+    template <class Visit>
+    static void ForEachPoint(const PointBlock& block, Visit visit) {
+        size_t n = block.headCount;
+        for (const PointChunk* c = block.head.get(); c; c = c->next.get(), n = ChunkPoints)
+            for (size_t i = 0; i < n; ++i) visit(c->points[i]);
+    }
+
+    // One published skeleton plus the current point block of every leaf
+    struct Version {
+        vector<int> nodeX, nodeY, nodeWidth, nodeHeight, nodeLevel, nodeID;
+        vector<int> firstChild, childCount;  // Children are contiguous
+        vector<int> parentNode;              // -1 for the root
+        vector<int> leafSlot;                // Index into blocks for leaves, -1 otherwise
+        vector<int> partBegin, partEnd;      // Node n stores partitionPool[partBegin[n] .. partEnd[n])
+        vector<int> partitionPool;
+        vector<Rect> partitionBox;           // Indexed by partition ID
+        vector<string> partitionName;
+        unique_ptr<atomic<const PointBlock*>[]> blocks;
+        unique_ptr<mutex[]> leafLocks;
+        size_t leafCount = 0;
+
+        ~Version();
+        bool InNode(int n, int x, int y) const;
+        int Descend(int x, int y, PointResult& result) const; // Leaf node index or -1
+    };
+
+    atomic<Version*> current;
+    shared_mutex publishMutex;  // Point writers shared, Publish exclusive
+    mutable EpochDomain epochs;
+
+    void ReplaceBlock(Version& v, int slot, const PointBlock* block);
+
+public:
+    ConcurrentQuadtree();
+    ~ConcurrentQuadtree();
+    ConcurrentQuadtree(const ConcurrentQuadtree&) = delete;
+    ConcurrentQuadtree& operator=(const ConcurrentQuadtree&) = delete;
+
+    // Snapshots the shape of tree (built over graph) and publishes it. Points
+    // already held are carried over into the new leaves. Safe while readers run.
+    void Publish(const QuadtreeNode& tree, const ChannelGraph& graph);
+
+    bool IsPublished() const { return current.load() != nullptr; }
+
+    // Withdraws the published tree and its points (e.g. when its partitions are
+    // replaced); readers then see an empty tree. Safe while readers run.
+    void Unpublish();
+
+    // ---- Readers: lock-free, callable from any number of threads ----
+
+    // Leaf, path and partitions holding (x, y), as QuadtreeNode::SearchPoint
+    PointResult SearchPoint(int x, int y) const;
+
+    // Partition IDs overlapping the rectangle (corners in any order), in visit order
+    void RectQuery(int x1, int y1, int x2, int y2, vector<int>& out) const;
+
+    // Stored points inside the closed rectangle
+    vector<pair<int, int>> PointsInRect(int x1, int y1, int x2, int y2) const;
+
+    size_t PointCount() const;
+    string PartitionName(int pid) const;
+
+    // ---- Writers: per-leaf locking, concurrent with readers and each other ----
+
+    PointResult InsertPoint(int x, int y);
+    PointResult DeletePoint(int x, int y);
+
+    // Retired blocks/skeletons waiting for readers to move on
+    size_t PendingReclaim() const { return epochs.PendingCount(); }
+};
+
+#endif
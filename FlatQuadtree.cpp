@@ -0,0 +1,288 @@
+#include "FlatQuadtree.h"
+#include <sstream>
+
+// ================= Construction ============================
+
+// Creates the tree with only its root node
+FlatQuadtree::FlatQuadtree(const Vertex& r, ChannelGraph* g) : graphPtr(g) {
+    AddNode(r.x, r.y, r.width, r.height, r.level, -1);
+}
+
+// Appends a node to every array and returns its index
+int FlatQuadtree::AddNode(int x, int y, int w, int h, int level, int parent) {
+    int n = (int)nodeX.size();
+    nodeX.push_back(x);
+    nodeY.push_back(y);
+    nodeWidth.push_back(w);
+    nodeHeight.push_back(h);
+    nodeLevel.push_back(level);
+    nodeParent.push_back(parent);
+    firstChild.push_back(-1);
+    childCount.push_back(0);
+    partBegin.push_back(0);
+    partEnd.push_back(0);
+    return n;
+}
+
+// =================== Subdivision =============================
+
+// Drops any previous subdivision and rebuilds the tree below the root
+void FlatQuadtree::Subdivide(int minW, int minH, int scale, bool stopWhenUniform) {
+    Vertex root(nodeX[0], nodeY[0], nodeWidth[0], nodeHeight[0], nodeLevel[0]);
+    for (auto* arr : {&nodeX, &nodeY, &nodeWidth, &nodeHeight, &nodeLevel,
+                      &nodeParent, &firstChild, &childCount, &partBegin, &partEnd})
+        arr->clear();
+    partitionPool.clear();
+    leafNodes.clear();
+    points.clear();
+    pointLeaf.clear();
+    AddNode(root.x, root.y, root.width, root.height, root.level, -1);
+
+    vector<int> all;
+    for (auto vertexID : boost::make_iterator_range(vertices(*graphPtr)))
+        all.push_back((int)vertexID);
+    vector<int> ids;
+    FilterPartitions(0, all, ids);
+    SubdivideNode(0, minW, minH, scale, stopWhenUniform, ids);
+}
+
+// Keeps the partitions from parentIDs that overlap node n
+void FlatQuadtree::FilterPartitions(int n, const vector<int>& parentIDs, vector<int>& out) const {
+    auto& graph = *graphPtr;
+    int x = nodeX[n], y = nodeY[n], w = nodeWidth[n], h = nodeHeight[n];
+    for (int pid : parentIDs) {
+        const Partition& partition = graph[pid];
+        bool overlaps = !(partition.x2 <= x || partition.x1 >= x + w ||
+                          partition.y2 <= y || partition.y1 >= y + h);
+        if (overlaps) out.push_back(pid);
+    }
+}
+
+// Empty, or lying entirely inside a single partition
+bool FlatQuadtree::IsUniform(int n, const vector<int>& ids) const {
+    if (ids.empty()) return true;
+    if (ids.size() != 1) return false;
+    const Partition& p = (*graphPtr)[ids[0]];
+    return p.x1 <= nodeX[n] && p.x2 >= nodeX[n] + nodeWidth[n] &&
+           p.y1 <= nodeY[n] && p.y2 >= nodeY[n] + nodeHeight[n];
+}
+
+// Same splitting rule and creation order as QuadtreeNode::Subdivide, so node IDs match.
+// ids holds the partitions overlapping node n; children filter that list.
+void FlatQuadtree::SubdivideNode(int n, int minW, int minH, int scale, bool stopWhenUniform, const vector<int>& ids) {
+    int x = nodeX[n], y = nodeY[n], w = nodeWidth[n], h = nodeHeight[n];
+
+    // Base case: small enough (or uniform) to stop subdividing
+    if ((w <= minW && h <= minH) || (stopWhenUniform && IsUniform(n, ids))) {
+        partBegin[n] = (int)partitionPool.size();
+        partitionPool.insert(partitionPool.end(), ids.begin(), ids.end());
+        partEnd[n] = (int)partitionPool.size();
+        leafNodes.push_back(n);
+        return;
+    }
+
+    int subWidth = (w + scale - 1) / scale;
+    int subHeight = (h + scale - 1) / scale;
+    int nextLevel = nodeLevel[n] + 1;
+
+    // Children of one node are appended back to back
+    int first = (int)nodeX.size();
+    for (int i = 0; i < scale; ++i) {
+        for (int j = 0; j < scale; ++j) {
+            int childX = x + i * subWidth;
+            int childY = y + j * subHeight;
+
+            int actualWidth = std::min(subWidth, x + w - childX);
+            int actualHeight = std::min(subHeight, y + h - childY);
+
+            if (actualWidth > 0 && actualHeight > 0)
+                AddNode(childX, childY, actualWidth, actualHeight, nextLevel, n);
+        }
+    }
+    int count = (int)nodeX.size() - first;
+    firstChild[n] = count ? first : -1;
+    childCount[n] = count;
+
+    for (int c = first; c < first + count; ++c) {
+        vector<int> childIDs;
+        FilterPartitions(c, ids, childIDs);
+        SubdivideNode(c, minW, minH, scale, stopWhenUniform, childIDs);
+    }
+}
+
+// ================= Point location ============================
+
+// Returns true if point (x, y) lies within node n's region
+bool FlatQuadtree::InNode(int n, int x, int y) const {
+    return (x >= nodeX[n] && x <= nodeX[n] + nodeWidth[n] &&
+            y >= nodeY[n] && y <= nodeY[n] + nodeHeight[n]);
+}
+
+// Walks from the root to the node holding (x, y), filling the status, path,
+// node ID and region of result. Returns the leaf index, or -1 when the point
+// is outside the root or no child covers it (status NoLeaf, deepest node).
+int FlatQuadtree::Descend(int x, int y, PointResult& result) const {
+    if (!InNode(0, x, y)) {
+        result.status = PointStatus::OutsideBoundary;
+        return -1;
+    }
+    int n = 0;
+    result.path.push_back(n + 1);
+    while (childCount[n] != 0) {
+        int next = -1;
+        for (int c = firstChild[n]; c < firstChild[n] + childCount[n]; ++c) {
+            if (InNode(c, x, y)) { next = c; break; }
+        }
+        if (next < 0) break;
+        n = next;
+        result.path.push_back(n + 1);
+    }
+    result.leafID = n + 1;
+    result.region = {nodeX[n], nodeY[n], nodeX[n] + nodeWidth[n], nodeY[n] + nodeHeight[n]};
+    result.status = childCount[n] == 0 ? PointStatus::Ok : PointStatus::NoLeaf;
+    return childCount[n] == 0 ? n : -1;
+}
+
+// ================ Insert Point ==============================
+PointResult FlatQuadtree::InsertPoint(int x, int y) {
+    PointResult result;
+    int leaf = Descend(x, y, result);
+    if (leaf < 0) return result;
+    points.emplace_back(x, y);
+    pointLeaf.push_back(leaf);
+    return result;
+}
+
+// ================ Search Point ==============================
+PointResult FlatQuadtree::SearchPoint(int x, int y) const {
+    PointResult result;
+    int n = Descend(x, y, result);
+    if (n < 0) return result;
+    for (int k = partBegin[n]; k < partEnd[n]; ++k) {
+        const Partition& p = (*graphPtr)[partitionPool[k]];
+        if (x >= p.x1 && x <= p.x2 && y >= p.y1 && y <= p.y2) result.partitions.push_back(partitionPool[k]);
+    }
+    return result;
+}
+
+// =================== Delete Point ============================
+// Removes one stored copy of (x, y) from its leaf; the last point takes its slot
+PointResult FlatQuadtree::DeletePoint(int x, int y) {
+    PointResult result;
+    int leaf = Descend(x, y, result);
+    if (leaf < 0) return result;
+    for (size_t i = 0; i < points.size(); ++i) {
+        if (pointLeaf[i] != leaf || points[i] != make_pair(x, y)) continue;
+        points[i] = points.back();
+        pointLeaf[i] = pointLeaf.back();
+        points.pop_back();
+        pointLeaf.pop_back();
+        return result;
+    }
+    result.status = PointStatus::NotFound;
+    return result;
+}
+
+// ================ Path To Root ==============================
+PointStatus FlatQuadtree::PathToRoot(int x, int y, vector<int>& path) const {
+    PointResult result;
+    Descend(x, y, result);
+    path.insert(path.end(), result.path.begin(), result.path.end());
+    return result.status;
+}
+
+// ================ Rectangle Query ==========================
+
+// Appends IDs of partitions in leaves under n that overlap the rectangle (may repeat)
+void FlatQuadtree::CollectRect(int n, int x1, int y1, int x2, int y2, vector<int>& out) const {
+    if (nodeX[n] + nodeWidth[n] <= x1 || nodeX[n] >= x2 ||
+        nodeY[n] + nodeHeight[n] <= y1 || nodeY[n] >= y2)
+        return;
+    if (childCount[n] == 0) {
+        for (int k = partBegin[n]; k < partEnd[n]; ++k) {
+            const Partition& p = (*graphPtr)[partitionPool[k]];
+            if (max(x1, p.x1) < min(x2, p.x2) && max(y1, p.y1) < min(y2, p.y2))
+                out.push_back(partitionPool[k]);
+        }
+        return;
+    }
+    for (int c = firstChild[n]; c < firstChild[n] + childCount[n]; ++c)
+        CollectRect(c, x1, y1, x2, y2, out);
+}
+
+vector<string> FlatQuadtree::RectQuery(int x1, int y1, int x2, int y2) {
+    vector<int> ids;
+    CollectRect(0, min(x1, x2), min(y1, y2), max(x1, x2), max(y1, y2), ids);
+    return NamesOf(ids);
+}
+
+// ================ Line (Net) Intersection ===================
+
+// Same exact segment tests as QuadtreeNode::NetIntersect, appending partition IDs (may repeat)
+void FlatQuadtree::CollectLine(int n, int xs, int ys, int xe, int ye, vector<int>& out) const {
+    if (!SegmentIntersectsBox(xs, ys, xe, ye, nodeX[n], nodeY[n],
+                              nodeX[n] + nodeWidth[n], nodeY[n] + nodeHeight[n]))
+        return;
+    if (childCount[n] == 0) {
+        for (int k = partBegin[n]; k < partEnd[n]; ++k) {
+            const Partition& p = (*graphPtr)[partitionPool[k]];
+            if (SegmentIntersectsBox(xs, ys, xe, ye, p.x1, p.y1, p.x2, p.y2))
+                out.push_back(partitionPool[k]);
+        }
+        return;
+    }
+    for (int c = firstChild[n]; c < firstChild[n] + childCount[n]; ++c)
+        CollectLine(c, xs, ys, xe, ye, out);
+}
+
+vector<string> FlatQuadtree::NetIntersect(int x1, int y1, int x2, int y2) {
+    vector<int> ids;
+    CollectLine(0, x1, y1, x2, y2, ids);
+    return NamesOf(ids);
+}
+
+// Deduplicates collected partition IDs and maps them to names
+vector<string> FlatQuadtree::NamesOf(vector<int>& ids) const {
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
+    vector<string> names;
+    names.reserve(ids.size());
+    for (int id : ids) names.push_back((*graphPtr)[id].name);
+    return names;
+}
+
+// ======================= DOT Visualization ==========================
+string FlatQuadtree::GetDotRepresentation() const {
+    std::ostringstream out;
+    out << "digraph Quadtree {\n"
+        << "  node [shape=box];\n";
+    GenerateDot(0, out);
+    out << "}\n";
+    return out.str();
+}
+
+void FlatQuadtree::GenerateDot(int n, std::ostream& out) const {
+    out << "  " << n + 1
+        << " [label=\"ID: " << n + 1
+        << "\\n(" << nodeX[n] << ',' << nodeY[n]
+        << ")-(" << nodeX[n] + nodeWidth[n] << ',' << nodeY[n] + nodeHeight[n] << ")\"];\n";
+    for (int c = firstChild[n]; c >= 0 && c < firstChild[n] + childCount[n]; ++c) {
+        GenerateDot(c, out);
+        out << "  " << n + 1 << " -> " << c + 1 << ";\n";
+    }
+}
+
+// ================ Statistics ================================
+int FlatQuadtree::LeafCount() const {
+    return (int)leafNodes.size();
+}
+
+size_t FlatQuadtree::MemoryBytes() const {
+    size_t bytes = 0;
+    for (auto* arr : {&nodeX, &nodeY, &nodeWidth, &nodeHeight, &nodeLevel,
+                      &nodeParent, &firstChild, &childCount, &partBegin, &partEnd,
+                      &partitionPool, &leafNodes, &pointLeaf})
+        bytes += arr->capacity() * sizeof(int);
+    bytes += points.capacity() * sizeof(pair<int, int>);
+    return bytes;
+}
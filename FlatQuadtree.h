@@ -0,0 +1,86 @@
+#ifndef FLAT_QUADTREE_H
+#define FLAT_QUADTREE_H
+#include <vector>
+#include <string>
+#include <iostream>
+#include "Quadtree.h"
+#include "ChannelGraph.h"
+using namespace std;
+
+// Pointer-free quadtree: every node lives in one set of parallel arrays (SoA),
+// children are referenced by index and all leaf partition IDs share one pool.
+// Exposes the same query API as QuadtreeNode.
+class FlatQuadtree {
+private:
+    // Node arrays, indexed by node index (root is 0, node ID is index + 1)
+    vector<int> nodeX, nodeY, nodeWidth, nodeHeight, nodeLevel;
+    vector<int> nodeParent;     // Parent index (-1 for the root)
+    vector<int> firstChild;     // Index of the first child, children are contiguous
+    vector<int> childCount;     // Number of children (0 for leaves)
+
+    // Shared partition pool: node n owns partitionPool[partBegin[n] .. partEnd[n])
+    vector<int> partBegin, partEnd;
+    vector<int> partitionPool;
+
+    vector<int> leafNodes;              // Leaf indices in build order
+    vector<pair<int, int>> points;      // Inserted points
+    vector<int> pointLeaf;              // Leaf index owning each point
+
+    ChannelGraph* graphPtr; // Pointer to the associated channel graph
+
+    int AddNode(int x, int y, int w, int h, int level, int parent);
+    void SubdivideNode(int n, int minW, int minH, int scale, bool stopWhenUniform, const vector<int>& ids);
+    void FilterPartitions(int n, const vector<int>& parentIDs, vector<int>& out) const;
+    bool IsUniform(int n, const vector<int>& ids) const;
+    bool InNode(int n, int x, int y) const;
+    int Descend(int x, int y, PointResult& result) const;
+    void CollectRect(int n, int x1, int y1, int x2, int y2, vector<int>& out) const;
+    void CollectLine(int n, int xs, int ys, int xe, int ye, vector<int>& out) const;
+    vector<string> NamesOf(vector<int>& ids) const;
+    void GenerateDot(int n, std::ostream& out) const;
+
+public:
+    // Creates a tree with only a root node covering region r
+    FlatQuadtree(const Vertex& r, ChannelGraph* g);
+
+    // Subdivides the root recursively, same rules as QuadtreeNode::Subdivide
+    void Subdivide(int minW, int minH, int scale, bool stopWhenUniform = false);
+
+    // Point operations fill a PointResult instead of printing; node IDs are
+    // index + 1, matching QuadtreeNode's numbering
+
+    // Inserts a point (x, y) into the appropriate leaf node
+    PointResult InsertPoint(int x, int y);
+
+    // Finds the leaf holding (x, y), the path to it and the partitions containing the point
+    PointResult SearchPoint(int x, int y) const;
+
+    // Removes the stored point (x, y) from its leaf (NotFound if it is not stored)
+    PointResult DeletePoint(int x, int y);
+
+    // Appends the node IDs from the root down to the leaf holding (x, y)
+    PointStatus PathToRoot(int x, int y, vector<int>& path) const;
+
+    // Returns list of partition names that intersect the rectangle defined by (x1,y1)-(x2,y2)
+    vector<string> RectQuery(int x1, int y1, int x2, int y2);
+
+    // Returns list of partition names that a line segment (x1,y1)-(x2,y2) intersects
+    vector<string> NetIntersect(int x1, int y1, int x2, int y2);
+
+    // Returns a string in DOT format representing the whole tree
+    string GetDotRepresentation() const;
+
+    // Checks if a point (x,y) lies within the root boundary
+    bool InBoundary(int x, int y) const { return InNode(0, x, y); }
+
+    // Number of leaves
+    int LeafCount() const;
+
+    size_t NodeCount() const { return nodeX.size(); }
+    const vector<int>& GetLeafNodes() const { return leafNodes; }
+
+    // Approximate heap footprint of the node arrays and the partition pool
+    size_t MemoryBytes() const;
+};
+
+#endif
@@ -0,0 +1,233 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+#include <algorithm>
+#include <cstdint>
+#ifdef __AVX2__
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GEOMETRY_SSE2
+#endif
+
+// Exact segment vs. closed box test on integer coordinates.
+// The segment hits the box when their bounding boxes overlap and the box's
+// corners are not all strictly on one side of the segment's line (separating
+// axis test, equivalent to slab clipping but without divisions).
+// Sign of u * v - w * z for |u|, |v|, |w|, |z| < 2^32. The products need 64
+// unsigned bits, so they are compared as sign and magnitude.
+inline int CrossSign(long long u, long long v, long long w, long long z) {
+    int sa = (u > 0) - (u < 0), sb = (w > 0) - (w < 0);
+    sa *= (v > 0) - (v < 0);
+    sb *= (z > 0) - (z < 0);
+    if (sa != sb) return sa > sb ? 1 : -1;
+    if (sa == 0) return 0;
+    unsigned long long ma = (unsigned long long)(u < 0 ? -u : u) * (unsigned long long)(v < 0 ? -v : v);
+    unsigned long long mb = (unsigned long long)(w < 0 ? -w : w) * (unsigned long long)(z < 0 ? -z : z);
+    if (ma == mb) return 0;
+    return (ma > mb) == (sa > 0) ? 1 : -1;
+}
+
+// Exact segment vs. closed box test on integer coordinates.
+// The segment hits the box when their bounding boxes overlap and the box's
+// corners are not all strictly on one side of the segment's line (separating
+// axis test, equivalent to slab clipping but without divisions). The box is
+// clamped to the segment's bounding box first (the segment lies inside it), so
+// each difference stays within |dx| or |dy| and the sides fit in 64 bits
+// whenever both spans fit in 32; longer segments use CrossSign.
+inline bool SegmentIntersectsBox(int xs, int ys, int xe, int ye,
+                                 int bx1, int by1, int bx2, int by2) {
+    int loX = std::min(xs, xe), hiX = std::max(xs, xe);
+    int loY = std::min(ys, ye), hiY = std::max(ys, ye);
+    if (hiX < bx1 || loX > bx2 || hiY < by1 || loY > by2)
+        return false;
+    bx1 = std::min(std::max(bx1, loX), hiX); bx2 = std::min(std::max(bx2, loX), hiX);
+    by1 = std::min(std::max(by1, loY), hiY); by2 = std::min(std::max(by2, loY), hiY);
+
+    long long dx = (long long)xe - xs, dy = (long long)ye - ys;
+    long long py1 = (long long)by1 - ys, py2 = (long long)by2 - ys;
+    long long px1 = (long long)bx1 - xs, px2 = (long long)bx2 - xs;
+    int c1, c2, c3, c4;
+    if (dx >= -INT32_MAX && dx <= INT32_MAX && dy >= -INT32_MAX && dy <= INT32_MAX) {
+        long long a1 = dx * py1, a2 = dx * py2, b1 = dy * px1, b2 = dy * px2;
+        c1 = (a1 > b1) - (a1 < b1); c2 = (a2 > b1) - (a2 < b1);
+        c3 = (a1 > b2) - (a1 < b2); c4 = (a2 > b2) - (a2 < b2);
+    } else {
+        c1 = CrossSign(dx, py1, dy, px1); c2 = CrossSign(dx, py2, dy, px1);
+        c3 = CrossSign(dx, py1, dy, px2); c4 = CrossSign(dx, py2, dy, px2);
+    }
+    bool allAbove = c1 > 0 && c2 > 0 && c3 > 0 && c4 > 0;
+    bool allBelow = c1 < 0 && c2 < 0 && c3 < 0 && c4 < 0;
+    return !allAbove && !allBelow;
+}
+
+// Liang-Barsky clip of the segment against a closed box. Returns the parameter
+// t in [0, 1] where the segment enters the box, or -1 if it misses it.
+inline double SegmentBoxEntry(int xs, int ys, int xe, int ye,
+                              int bx1, int by1, int bx2, int by2) {
+    double t0 = 0.0, t1 = 1.0;
+    double dx = (double)xe - xs, dy = (double)ye - ys;
+    double p[4] = {-dx, dx, -dy, dy};
+    double q[4] = {(double)xs - bx1, (double)bx2 - xs, (double)ys - by1, (double)by2 - ys};
+    for (int k = 0; k < 4; ++k) {
+        if (p[k] == 0) {
+            if (q[k] < 0) return -1.0;  // parallel to this slab and outside it
+            continue;
+        }
+        double t = q[k] / p[k];
+        if (p[k] < 0) t0 = std::max(t0, t);
+        else t1 = std::min(t1, t);
+        if (t0 > t1) return -1.0;
+    }
+    return t0;
+}
+
+// ---- Batch kernels over SoA boxes ----
+// Each tests n boxes stored as x1[], y1[], x2[], y2[], writes the indices of
+// the matching ones to hits in increasing order and returns how many matched.
+// Vector steps turn a lane mask into indices without branches.
+
+// Appends i + k for every set bit k of mask (lanes of one vector step)
+inline int AppendMaskHits(int mask, int lanes, int i, int count, int* hits) {
+    for (int k = 0; k < lanes; ++k) {
+        hits[count] = i + k;
+        count += (mask >> k) & 1;
+    }
+    return count;
+}
+
+// Point inside the closed box. AVX2: 8 boxes per step, SSE2: 4.
+inline int PointInBoxes(int x, int y, const int* x1, const int* y1, const int* x2, const int* y2,
+                        int n, int* hits) {
+    int i = 0, count = 0;
+#ifdef __AVX2__
+    const __m256i px = _mm256_set1_epi32(x), py = _mm256_set1_epi32(y);
+    for (; i + 8 <= n; i += 8) {
+        __m256i miss = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)(x1 + i)), px),
+                            _mm256_cmpgt_epi32(px, _mm256_loadu_si256((const __m256i*)(x2 + i)))),
+            _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)(y1 + i)), py),
+                            _mm256_cmpgt_epi32(py, _mm256_loadu_si256((const __m256i*)(y2 + i)))));
+        count = AppendMaskHits(~_mm256_movemask_ps(_mm256_castsi256_ps(miss)), 8, i, count, hits);
+    }
+#elif defined(GEOMETRY_SSE2)
+    const __m128i px = _mm_set1_epi32(x), py = _mm_set1_epi32(y);
+    for (; i + 4 <= n; i += 4) {
+        __m128i miss = _mm_or_si128(
+            _mm_or_si128(_mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(x1 + i)), px),
+                         _mm_cmpgt_epi32(px, _mm_loadu_si128((const __m128i*)(x2 + i)))),
+            _mm_or_si128(_mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(y1 + i)), py),
+                         _mm_cmpgt_epi32(py, _mm_loadu_si128((const __m128i*)(y2 + i)))));
+        count = AppendMaskHits(~_mm_movemask_ps(_mm_castsi128_ps(miss)), 4, i, count, hits);
+    }
+#endif
+    for (; i < n; ++i) {
+        hits[count] = i;
+        count += x >= x1[i] && x <= x2[i] && y >= y1[i] && y <= y2[i];
+    }
+    return count;
+}
+
+// Positive-area overlap with the normalized rectangle (qx1, qy1)-(qx2, qy2), the
+// same as max(qx1, x1) < min(qx2, x2) && max(qy1, y1) < min(qy2, y2), so
+// empty or inverted boxes never match. AVX2: 8 boxes per step, SSE2: 4.
+inline int RectOverlapsBoxes(int qx1, int qy1, int qx2, int qy2,
+                             const int* x1, const int* y1, const int* x2, const int* y2,
+                             int n, int* hits) {
+    if (qx1 >= qx2 || qy1 >= qy2) return 0;
+    int i = 0, count = 0;
+#ifdef __AVX2__
+    const __m256i ax1 = _mm256_set1_epi32(qx1), ay1 = _mm256_set1_epi32(qy1);
+    const __m256i ax2 = _mm256_set1_epi32(qx2), ay2 = _mm256_set1_epi32(qy2);
+    for (; i + 8 <= n; i += 8) {
+        __m256i bx1 = _mm256_loadu_si256((const __m256i*)(x1 + i)), bx2 = _mm256_loadu_si256((const __m256i*)(x2 + i));
+        __m256i by1 = _mm256_loadu_si256((const __m256i*)(y1 + i)), by2 = _mm256_loadu_si256((const __m256i*)(y2 + i));
+        __m256i inX = _mm256_and_si256(_mm256_and_si256(_mm256_cmpgt_epi32(bx2, ax1), _mm256_cmpgt_epi32(ax2, bx1)),
+                                       _mm256_cmpgt_epi32(bx2, bx1));
+        __m256i inY = _mm256_and_si256(_mm256_and_si256(_mm256_cmpgt_epi32(by2, ay1), _mm256_cmpgt_epi32(ay2, by1)),
+                                       _mm256_cmpgt_epi32(by2, by1));
+        count = AppendMaskHits(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_and_si256(inX, inY))), 8, i, count, hits);
+    }
+#elif defined(GEOMETRY_SSE2)
+    const __m128i ax1 = _mm_set1_epi32(qx1), ay1 = _mm_set1_epi32(qy1);
+    const __m128i ax2 = _mm_set1_epi32(qx2), ay2 = _mm_set1_epi32(qy2);
+    for (; i + 4 <= n; i += 4) {
+        __m128i bx1 = _mm_loadu_si128((const __m128i*)(x1 + i)), bx2 = _mm_loadu_si128((const __m128i*)(x2 + i));
+        __m128i by1 = _mm_loadu_si128((const __m128i*)(y1 + i)), by2 = _mm_loadu_si128((const __m128i*)(y2 + i));
+        __m128i inX = _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi32(bx2, ax1), _mm_cmpgt_epi32(ax2, bx1)),
+                                    _mm_cmpgt_epi32(bx2, bx1));
+        __m128i inY = _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi32(by2, ay1), _mm_cmpgt_epi32(ay2, by1)),
+                                    _mm_cmpgt_epi32(by2, by1));
+        count = AppendMaskHits(_mm_movemask_ps(_mm_castsi128_ps(_mm_and_si128(inX, inY))), 4, i, count, hits);
+    }
+#endif
+    for (; i < n; ++i) {
+        hits[count] = i;
+        count += std::max(qx1, x1[i]) < std::min(qx2, x2[i]) && std::max(qy1, y1[i]) < std::min(qy2, y2[i]);
+    }
+    return count;
+}
+
+// Exact segment test (SegmentIntersectsBox) against n boxes. The corner sides
+// need 64-bit products, so AVX2 tests four boxes per step; otherwise the loop
+// is scalar. Boxes are clamped to the segment's bounding box first (the segment
+// lies inside it, so the answer is the same), which keeps every difference
+// within |dx| or |dy|; segments spanning more than 2^31 - 1 on an axis take the
+// scalar loop.
+inline int SegmentIntersectsBoxes(int xs, int ys, int xe, int ye,
+                                  const int* x1, const int* y1, const int* x2, const int* y2,
+                                  int n, int* hits) {
+    int i = 0, count = 0;
+#ifdef __AVX2__
+    const long long spanX = (long long)xe - xs, spanY = (long long)ye - ys;
+    if (spanX >= -INT32_MAX && spanX <= INT32_MAX && spanY >= -INT32_MAX && spanY <= INT32_MAX) {
+        const __m256i sx = _mm256_set1_epi64x(xs), sy = _mm256_set1_epi64x(ys);
+        const __m256i dx = _mm256_set1_epi64x(spanX), dy = _mm256_set1_epi64x(spanY);
+        const __m256i loX = _mm256_set1_epi64x(std::min(xs, xe)), hiX = _mm256_set1_epi64x(std::max(xs, xe));
+        const __m256i loY = _mm256_set1_epi64x(std::min(ys, ye)), hiY = _mm256_set1_epi64x(std::max(ys, ye));
+        const __m128i loX32 = _mm_set1_epi32(std::min(xs, xe)), hiX32 = _mm_set1_epi32(std::max(xs, xe));
+        const __m128i loY32 = _mm_set1_epi32(std::min(ys, ye)), hiY32 = _mm_set1_epi32(std::max(ys, ye));
+        const __m256i zero = _mm256_setzero_si256();
+        for (; i + 4 <= n; i += 4) {
+            __m128i rx1 = _mm_loadu_si128((const __m128i*)(x1 + i)), ry1 = _mm_loadu_si128((const __m128i*)(y1 + i));
+            __m128i rx2 = _mm_loadu_si128((const __m128i*)(x2 + i)), ry2 = _mm_loadu_si128((const __m128i*)(y2 + i));
+
+            // Bounding boxes apart on either axis (on the boxes as stored)
+            __m256i apart = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpgt_epi64(_mm256_cvtepi32_epi64(rx1), hiX),
+                                _mm256_cmpgt_epi64(loX, _mm256_cvtepi32_epi64(rx2))),
+                _mm256_or_si256(_mm256_cmpgt_epi64(_mm256_cvtepi32_epi64(ry1), hiY),
+                                _mm256_cmpgt_epi64(loY, _mm256_cvtepi32_epi64(ry2))));
+
+            // Clamped corners
+            __m256i bx1 = _mm256_cvtepi32_epi64(_mm_min_epi32(_mm_max_epi32(rx1, loX32), hiX32));
+            __m256i by1 = _mm256_cvtepi32_epi64(_mm_min_epi32(_mm_max_epi32(ry1, loY32), hiY32));
+            __m256i bx2 = _mm256_cvtepi32_epi64(_mm_min_epi32(_mm_max_epi32(rx2, loX32), hiX32));
+            __m256i by2 = _mm256_cvtepi32_epi64(_mm_min_epi32(_mm_max_epi32(ry2, loY32), hiY32));
+
+            // Signed side of each corner relative to the segment's line
+            __m256i a1 = _mm256_mul_epi32(dx, _mm256_sub_epi64(by1, sy));
+            __m256i a2 = _mm256_mul_epi32(dx, _mm256_sub_epi64(by2, sy));
+            __m256i b1 = _mm256_mul_epi32(dy, _mm256_sub_epi64(bx1, sx));
+            __m256i b2 = _mm256_mul_epi32(dy, _mm256_sub_epi64(bx2, sx));
+            __m256i c1 = _mm256_sub_epi64(a1, b1), c2 = _mm256_sub_epi64(a2, b1);
+            __m256i c3 = _mm256_sub_epi64(a1, b2), c4 = _mm256_sub_epi64(a2, b2);
+            __m256i allAbove = _mm256_and_si256(
+                _mm256_and_si256(_mm256_cmpgt_epi64(c1, zero), _mm256_cmpgt_epi64(c2, zero)),
+                _mm256_and_si256(_mm256_cmpgt_epi64(c3, zero), _mm256_cmpgt_epi64(c4, zero)));
+            __m256i allBelow = _mm256_and_si256(
+                _mm256_and_si256(_mm256_cmpgt_epi64(zero, c1), _mm256_cmpgt_epi64(zero, c2)),
+                _mm256_and_si256(_mm256_cmpgt_epi64(zero, c3), _mm256_cmpgt_epi64(zero, c4)));
+
+            __m256i miss = _mm256_or_si256(apart, _mm256_or_si256(allAbove, allBelow));
+            count = AppendMaskHits(~_mm256_movemask_pd(_mm256_castsi256_pd(miss)), 4, i, count, hits);
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        hits[count] = i;
+        count += SegmentIntersectsBox(xs, ys, xe, ye, x1[i], y1[i], x2[i], y2[i]);
+    }
+    return count;
+}
+
+#endif
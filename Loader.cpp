@@ -0,0 +1,532 @@
+#include "Loader.h"
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char PARTITIONS_MAGIC[8] = {'Q', 'T', 'P', 'A', 'R', 'T', 'S', 0};
+static const char PINS_MAGIC[8] = {'Q', 'T', 'P', 'I', 'N', 'S', 0, 0};
+static const uint32_t LOAD_BYTE_ORDER = 0x01020304;
+
+static_assert(sizeof(Point) == 2 * sizeof(int32_t), "binary pins are stored as raw Point records");
+
+// ================= File blocks ==============================
+
+FileBlocks::FileBlocks()
+    : access(FileAccess::Mapped), base(nullptr), size(0), sizeKnown(false),
+#ifdef _WIN32
+      fileHandle(nullptr), mapHandle(nullptr),
+#endif
+      file(nullptr), pos(0), filled(0), eof(true) {}
+
+FileBlocks::~FileBlocks() {
+    Close();
+}
+
+void FileBlocks::Close() {
+    if (base) {
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+        CloseHandle((HANDLE)mapHandle);
+        CloseHandle((HANDLE)fileHandle);
+        mapHandle = fileHandle = nullptr;
+#else
+        munmap(base, size);
+#endif
+    }
+    if (file) fclose(file);
+    base = nullptr;
+    file = nullptr;
+    size = pos = filled = 0;
+    sizeKnown = false;
+    eof = true;
+    vector<char>().swap(buffer);
+}
+
+bool FileBlocks::Open(const string& path, FileAccess mode, string& error) {
+    Close();
+    access = mode;
+    if (mode == FileAccess::Buffered) {
+        file = fopen(path.c_str(), "rb");
+        if (!file) { error = "cannot open file"; return false; }
+        // Pipes cannot seek; their length stays unknown and reads find the end
+        long length = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+        sizeKnown = length >= 0 && fseek(file, 0, SEEK_SET) == 0;
+        size = sizeKnown ? (size_t)length : 0;
+        eof = false;
+        return true;
+    }
+
+    // An empty file has nothing to map and simply holds no records
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) { error = "cannot open file"; return false; }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(handle, &fileSize);
+    if (fileSize.QuadPart == 0) {
+        CloseHandle(handle);
+        return true;
+    }
+    HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(handle);
+        error = "cannot map file";
+        return false;
+    }
+    fileHandle = handle;
+    mapHandle = mapping;
+    base = view;
+    size = (size_t)fileSize.QuadPart;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) { error = "cannot open file"; return false; }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        error = "cannot stat file";
+        return false;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return true;
+    }
+    void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // the mapping stays valid
+    if (view == MAP_FAILED) { error = "cannot map file"; return false; }
+#ifdef MADV_SEQUENTIAL
+    madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);  // one front-to-back pass
+#endif
+    base = view;
+    size = (size_t)st.st_size;
+#endif
+    filled = size;
+    return true;
+}
+
+// Moves the unconsumed bytes to the front and reads whole chunks behind them
+bool FileBlocks::Fill(size_t atLeast) {
+    while (filled - pos < atLeast && !eof) {
+        if (pos > 0) {
+            memmove(buffer.data(), buffer.data() + pos, filled - pos);
+            filled -= pos;
+            pos = 0;
+        }
+        if (buffer.size() < filled + ChunkBytes) buffer.resize(filled + ChunkBytes);
+        size_t got = fread(buffer.data() + filled, 1, ChunkBytes, file);
+        filled += got;
+        if (got < ChunkBytes) eof = true;
+    }
+    return filled - pos >= atLeast;
+}
+
+bool FileBlocks::StartsWith(const char* prefix, size_t length) {
+    if (access == FileAccess::Mapped)
+        return size - pos >= length && memcmp((const char*)base + pos, prefix, length) == 0;
+    return Fill(length) && memcmp(buffer.data() + pos, prefix, length) == 0;
+}
+
+bool FileBlocks::NextLines(const char*& begin, const char*& end) {
+    if (access == FileAccess::Mapped) {
+        if (pos >= size) return false;
+        begin = (const char*)base + pos;
+        end = (const char*)base + size;
+        pos = size;
+        return true;
+    }
+    // Read until the unconsumed bytes hold a line break (or the file ends), so a
+    // line longer than a chunk still comes out whole
+    size_t scanned = 0;
+    while (true) {
+        const char* from = buffer.data() + pos + scanned;
+        size_t available = filled - pos - scanned;
+        const char* last = nullptr;
+        for (const char* p = from + available; p-- > from;) {
+            if (*p == '\n') { last = p; break; }
+        }
+        if (last) {
+            begin = buffer.data() + pos;
+            end = last + 1;
+            pos = end - buffer.data();
+            return true;
+        }
+        if (eof) break;
+        scanned = filled - pos;
+        Fill(filled - pos + 1);
+    }
+    if (pos >= filled) return false;
+    begin = buffer.data() + pos;
+    end = buffer.data() + filled;
+    pos = filled;
+    return true;
+}
+
+bool FileBlocks::Read(void* out, size_t bytes) {
+    if (access == FileAccess::Mapped) {
+        if (size - pos < bytes) return false;
+        memcpy(out, (const char*)base + pos, bytes);
+        pos += bytes;
+        return true;
+    }
+    // Buffered bytes first, then straight from the file without staging
+    size_t buffered = min(bytes, filled - pos);
+    memcpy(out, buffer.data() + pos, buffered);
+    pos += buffered;
+    size_t rest = bytes - buffered;
+    if (rest == 0) return true;
+    size_t got = eof ? 0 : fread((char*)out + buffered, 1, rest, file);
+    if (got < rest) eof = true;
+    return got == rest;
+}
+
+// ================= Text parsing =============================
+
+static inline bool IsSeparator(char c) {
+    return c == ' ' || c == '\t' || c == ',' || c == '\r';
+}
+
+static inline void SkipSeparators(const char*& p, const char* end) {
+    while (p < end && IsSeparator(*p)) ++p;
+}
+
+// Next field of the line as [begin, p); false when the line has no more fields
+static bool NextField(const char*& p, const char* end, const char*& begin) {
+    SkipSeparators(p, end);
+    begin = p;
+    while (p < end && !IsSeparator(*p)) ++p;
+    return p > begin;
+}
+
+// Decimal integer with optional sign; the whole field must be digits and fit in an int
+static bool ParseInt(const char*& p, const char* end, int& out) {
+    SkipSeparators(p, end);
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+')) ++p;
+    const char* digits = p;
+    long long v = 0;
+    while (p < end && (unsigned)(*p - '0') < 10) {
+        v = v * 10 + (*p - '0');
+        if (v > (long long)INT_MAX + 1) return false;
+        ++p;
+    }
+    if (p == digits || (p < end && !IsSeparator(*p))) return false;
+    v = negative ? -v : v;
+    if (v > INT_MAX) return false;
+    out = (int)v;
+    return true;
+}
+
+static bool AtLineEnd(const char*& p, const char* end) {
+    SkipSeparators(p, end);
+    return p == end;
+}
+
+// Calls parse(begin, end) on every non-blank, non-comment line with its 1-based
+// number; stops at the first line parse rejects and reports it in error
+template <class LineParser>
+static bool ForEachLine(FileBlocks& blocks, string& error, LineParser parse) {
+    const char* block;
+    const char* blockEnd;
+    size_t lineNumber = 0;
+    while (blocks.NextLines(block, blockEnd)) {
+        for (const char* line = block; line < blockEnd;) {
+            const char* newline = (const char*)memchr(line, '\n', blockEnd - line);
+            const char* lineEnd = newline ? newline : blockEnd;
+            ++lineNumber;
+            const char* p = line;
+            SkipSeparators(p, lineEnd);
+            if (p < lineEnd && *p != '#' && !parse(p, lineEnd)) {
+                error = "bad record on line " + to_string(lineNumber) + ": " + string(line, lineEnd);
+                return false;
+            }
+            line = lineEnd + 1;
+        }
+    }
+    return true;
+}
+
+// Reads the binary header and checks it against the file. Without a known
+// length (a pipe) the counts are trusted and truncation shows up while reading.
+static bool ReadHeader(FileBlocks& blocks, LoadFileHeader& h, size_t recordBytes, string& error) {
+    if (!blocks.Read(&h, sizeof(h))) { error = "truncated header"; return false; }
+    if (h.version != LOAD_FILE_VERSION) { error = "unsupported file version"; return false; }
+    if (h.byteOrder != LOAD_BYTE_ORDER) { error = "file written with a different byte order"; return false; }
+    if (!blocks.SizeKnown()) return true;
+    uint64_t payload = blocks.FileSize() - sizeof(h);
+    if (h.count > payload / recordBytes || h.nameBytes != payload - h.count * recordBytes) {
+        error = "record counts do not match the file size";
+        return false;
+    }
+    return true;
+}
+
+// Reads count elements into out, growing it a chunk at a time so a bad count
+// from a stream of unknown length fails on truncation, not on one huge allocation
+template <class Buffer>
+static bool ReadArray(FileBlocks& blocks, uint64_t count, Buffer& out) {
+    const uint64_t chunk = FileBlocks::ChunkBytes / sizeof(typename Buffer::value_type);
+    out.clear();
+    for (uint64_t done = 0; done < count;) {
+        size_t n = (size_t)min(chunk, count - done);
+        out.resize((size_t)done + n);
+        if (!blocks.Read(&out[(size_t)done], n * sizeof(typename Buffer::value_type))) return false;
+        done += n;
+    }
+    return true;
+}
+
+// ================= Partitions ===============================
+
+bool LoadPartitions(const string& path, vector<Partition>& out, string& error, FileAccess mode) {
+    out.clear();
+    FileBlocks blocks;
+    if (!blocks.Open(path, mode, error)) return false;
+
+    if (blocks.StartsWith(PARTITIONS_MAGIC, sizeof(PARTITIONS_MAGIC))) {
+        LoadFileHeader h;
+        if (!ReadHeader(blocks, h, sizeof(BinaryPartition), error)) return false;
+        vector<BinaryPartition> records;
+        string names;
+        if (!ReadArray(blocks, h.count, records) || !ReadArray(blocks, h.nameBytes, names)) {
+            error = "truncated file";
+            return false;
+        }
+        out.reserve(records.size());
+        for (size_t i = 0; i < records.size(); ++i) {
+            const BinaryPartition& r = records[i];
+            if ((uint64_t)r.nameOffset + r.nameLength > h.nameBytes) {
+                error = "bad name range in record " + to_string(i);
+                out.clear();
+                return false;
+            }
+            out.push_back({names.substr(r.nameOffset, r.nameLength), r.x1, r.y1, r.x2, r.y2});
+        }
+        return true;
+    }
+
+    // Text records are small, so guess the count from the file size up front
+    out.reserve(blocks.FileSize() / 24);
+    bool ok = ForEachLine(blocks, error, [&](const char* p, const char* end) {
+        const char* name;
+        Partition part;
+        if (!NextField(p, end, name)) return false;
+        part.name.assign(name, p - name);
+        if (!ParseInt(p, end, part.x1) || !ParseInt(p, end, part.y1) ||
+            !ParseInt(p, end, part.x2) || !ParseInt(p, end, part.y2) || !AtLineEnd(p, end))
+            return false;
+        out.push_back(std::move(part));
+        return true;
+    });
+    if (!ok) out.clear();
+    return ok;
+}
+
+bool SavePartitions(const string& path, const vector<Partition>& partitions, bool binary) {
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out) return false;
+    if (!binary) {
+        for (const Partition& p : partitions)
+            out << p.name << ' ' << p.x1 << ' ' << p.y1 << ' ' << p.x2 << ' ' << p.y2 << '\n';
+        return (bool)out;
+    }
+    vector<BinaryPartition> records;
+    string names;
+    for (const Partition& p : partitions) {
+        records.push_back({p.x1, p.y1, p.x2, p.y2, (uint32_t)names.size(), (uint32_t)p.name.size()});
+        names += p.name;
+    }
+    LoadFileHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, PARTITIONS_MAGIC, sizeof(h.magic));
+    h.version = LOAD_FILE_VERSION;
+    h.byteOrder = LOAD_BYTE_ORDER;
+    h.count = records.size();
+    h.nameBytes = names.size();
+    out.write((const char*)&h, sizeof(h));
+    out.write((const char*)records.data(), records.size() * sizeof(BinaryPartition));
+    out.write(names.data(), names.size());
+    return (bool)out;
+}
+
+// ================= Pins =====================================
+
+bool LoadPins(const string& path, vector<Point>& out, string& error, FileAccess mode) {
+    out.clear();
+    FileBlocks blocks;
+    if (!blocks.Open(path, mode, error)) return false;
+
+    if (blocks.StartsWith(PINS_MAGIC, sizeof(PINS_MAGIC))) {
+        LoadFileHeader h;
+        if (!ReadHeader(blocks, h, sizeof(Point), error)) return false;
+        if (!ReadArray(blocks, h.count, out)) {
+            error = "truncated file";
+            out.clear();
+            return false;
+        }
+        return true;
+    }
+
+    out.reserve(blocks.FileSize() / 10);
+    bool ok = ForEachLine(blocks, error, [&](const char* p, const char* end) {
+        // A pin name comes first when the line does not start with a number
+        const char* field;
+        if ((unsigned)(*p - '0') >= 10 && *p != '-' && *p != '+') NextField(p, end, field);
+        Point pin;
+        if (!ParseInt(p, end, pin.x) || !ParseInt(p, end, pin.y) || !AtLineEnd(p, end)) return false;
+        out.push_back(pin);
+        return true;
+    });
+    if (!ok) out.clear();
+    return ok;
+}
+
+bool SavePins(const string& path, const vector<Point>& pins, bool binary) {
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out) return false;
+    if (!binary) {
+        for (const Point& p : pins) out << p.x << ' ' << p.y << '\n';
+        return (bool)out;
+    }
+    LoadFileHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, PINS_MAGIC, sizeof(h.magic));
+    h.version = LOAD_FILE_VERSION;
+    h.byteOrder = LOAD_BYTE_ORDER;
+    h.count = pins.size();
+    out.write((const char*)&h, sizeof(h));
+    out.write((const char*)pins.data(), pins.size() * sizeof(Point));
+    return (bool)out;
+}
+
+// ================= Workloads ================================
+
+struct WorkloadCommand {
+    const char* name;
+    WorkloadOp op;
+    int args;
+};
+
+static const WorkloadCommand workloadCommands[] = {
+    {"RectQuery", WorkloadOp::RectQuery, 4},     {"NetIntersect", WorkloadOp::NetIntersect, 4},
+    {"SearchPoint", WorkloadOp::SearchPoint, 2}, {"InsertPoint", WorkloadOp::InsertPoint, 2},
+    {"DeletePoint", WorkloadOp::DeletePoint, 2}, {"NearestPoints", WorkloadOp::NearestPoints, 3},
+    {"RadiusQuery", WorkloadOp::RadiusQuery, 3},
+};
+
+bool LoadWorkload(const string& path, vector<WorkloadQuery>& out, string& error, FileAccess mode) {
+    out.clear();
+    FileBlocks blocks;
+    if (!blocks.Open(path, mode, error)) return false;
+    out.reserve(blocks.FileSize() / 24);
+    bool ok = ForEachLine(blocks, error, [&](const char* p, const char* end) {
+        const char* name;
+        if (!NextField(p, end, name)) return false;
+        size_t length = p - name;
+        for (const WorkloadCommand& c : workloadCommands) {
+            if (strlen(c.name) != length || memcmp(c.name, name, length) != 0) continue;
+            WorkloadQuery q = {c.op, 0, 0, 0, 0};
+            int* args[4] = {&q.a, &q.b, &q.c, &q.d};
+            for (int k = 0; k < c.args; ++k)
+                if (!ParseInt(p, end, *args[k])) return false;
+            if (!AtLineEnd(p, end)) return false;
+            out.push_back(q);
+            return true;
+        }
+        return false;
+    });
+    if (!ok) out.clear();
+    return ok;
+}
+
+// Appends v in decimal
+static inline void AppendInt(string& s, int v) {
+    char digits[12];
+    char* last = to_chars(digits, digits + sizeof(digits), v).ptr;
+    s.append(digits, last);
+}
+
+WorkloadReport RunWorkload(QuadtreeNode& tree, const vector<WorkloadQuery>& queries, ostream& out,
+                           QueryCache* cache) {
+    WorkloadReport report;
+    QueryScratch scratch;
+    vector<int> ids;
+    string text;  // Output is formatted here and written in large pieces
+    auto appendIds = [&](const vector<int>& list) {
+        for (size_t i = 0; i < list.size(); ++i) {
+            if (i) text += ' ';
+            AppendInt(text, list[i]);
+        }
+        report.results += list.size();
+    };
+    auto appendPoints = [&](const vector<pair<int, int>>& list) {
+        for (size_t i = 0; i < list.size(); ++i) {
+            if (i) text += ' ';
+            AppendInt(text, list[i].first);
+            text += ',';
+            AppendInt(text, list[i].second);
+        }
+        report.results += list.size();
+    };
+
+    auto start = chrono::high_resolution_clock::now();
+    for (const WorkloadQuery& q : queries) {
+        switch (q.op) {
+        case WorkloadOp::RectQuery:
+            if (cache) cache->RectQuery(q.a, q.b, q.c, q.d, ids);
+            else tree.RectQuery(q.a, q.b, q.c, q.d, ids, scratch);
+            appendIds(ids);
+            break;
+        case WorkloadOp::NetIntersect:
+            if (cache) cache->NetIntersect(q.a, q.b, q.c, q.d, ids);
+            else tree.NetIntersect(q.a, q.b, q.c, q.d, ids, scratch);
+            appendIds(ids);
+            break;
+        case WorkloadOp::SearchPoint: {
+            PointResult r = cache ? cache->SearchPoint(q.a, q.b) : tree.SearchPoint(q.a, q.b);
+            if (r.status == PointStatus::Ok) AppendInt(text, r.leafID);
+            else text += '-';
+            text += ':';
+            if (!r.partitions.empty()) text += ' ';
+            appendIds(r.partitions);
+            break;
+        }
+        case WorkloadOp::InsertPoint:
+        case WorkloadOp::DeletePoint: {
+            PointResult r = q.op == WorkloadOp::InsertPoint ? tree.InsertPoint(q.a, q.b) : tree.DeletePoint(q.a, q.b);
+            if (r.status == PointStatus::Ok) AppendInt(text, r.leafID);
+            else text += '-';
+            break;
+        }
+        case WorkloadOp::NearestPoints:
+            appendPoints(tree.NearestPoints(q.a, q.b, q.c));
+            break;
+        case WorkloadOp::RadiusQuery:
+            appendPoints(tree.PointsInRadius(q.a, q.b, q.c));
+            break;
+        }
+        text += '\n';
+        ++report.perOp[(int)q.op];
+        if (text.size() >= (1 << 20)) {
+            out.write(text.data(), text.size());
+            text.clear();
+        }
+    }
+    out.write(text.data(), text.size());
+    out.flush();
+    auto end = chrono::high_resolution_clock::now();
+    report.queries = queries.size();
+    report.seconds = chrono::duration<double>(end - start).count();
+    return report;
+}
@@ -0,0 +1,130 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Quadtree.h"
+#include "ChannelGraph.h"
+#include "QueryCache.h"
+
+using namespace std;
+
+// ---- Input formats ----
+// Text: one record per line, fields separated by spaces, tabs or commas;
+// blank lines and lines starting with '#' are skipped.
+//   Partitions:  name x1 y1 x2 y2
+//   Pins:        [name] x y           (a leading non-numeric token is ignored)
+//   Workload:    RectQuery x1 y1 x2 y2 | NetIntersect x1 y1 x2 y2 | SearchPoint x y |
+//                InsertPoint x y | DeletePoint x y | NearestPoints x y k | RadiusQuery x y r
+// Binary (native byte order, detected by the magic): a LoadFileHeader, then
+//   Partitions:  count BinaryPartition records, then nameBytes of names
+//   Pins:        count Point records
+
+struct LoadFileHeader {
+    char magic[8];       // "QTPARTS\0" or "QTPINS\0\0"
+    uint32_t version;    // LOAD_FILE_VERSION
+    uint32_t byteOrder;  // 0x01020304 as written by the producer
+    uint64_t count;      // Records that follow
+    uint64_t nameBytes;  // Partitions only: size of the name section
+};
+
+struct BinaryPartition {
+    int32_t x1, y1, x2, y2;
+    uint32_t nameOffset, nameLength;  // Into the name section
+};
+
+const uint32_t LOAD_FILE_VERSION = 1;
+
+// How an input file is read: mapped into memory in one piece, or streamed
+// through a fixed-size buffer (for pipes, network mounts, or to cap memory)
+enum class FileAccess { Mapped, Buffered };
+
+// Hands out a file's bytes front to back. A mapped file is served straight from
+// the mapping; a buffered file is read in ChunkBytes pieces, and text blocks
+// always end on a line break so a record never straddles two blocks.
+class FileBlocks {
+private:
+    FileAccess access;
+    void* base;          // Mapping (Mapped)
+    size_t size;         // File length (0 when unknown)
+    bool sizeKnown;      // False for buffered streams that cannot seek (pipes)
+#ifdef _WIN32
+    void* fileHandle;
+    void* mapHandle;
+#endif
+    FILE* file;          // Buffered
+    vector<char> buffer; // Buffered: bytes [pos, filled) are read but not yet consumed
+    size_t pos, filled;  // Mapped: pos is the offset into the mapping
+    bool eof;            // Buffered: nothing left to read from file
+
+    bool Fill(size_t atLeast); // Buffered: tries to have atLeast unconsumed bytes
+
+public:
+    static const size_t ChunkBytes = 1 << 20;
+
+    FileBlocks();
+    ~FileBlocks();
+    FileBlocks(const FileBlocks&) = delete;
+    FileBlocks& operator=(const FileBlocks&) = delete;
+
+    bool Open(const string& path, FileAccess mode, string& error);
+    void Close();
+    size_t FileSize() const { return size; }
+    bool SizeKnown() const { return sizeKnown; }
+
+    // True if the unconsumed bytes start with prefix (nothing is consumed)
+    bool StartsWith(const char* prefix, size_t length);
+
+    // Next block of whole lines; false at end of file
+    bool NextLines(const char*& begin, const char*& end);
+
+    // Copies the next bytes of the file (binary records); false if the file ends first
+    bool Read(void* out, size_t bytes);
+};
+
+// Parses partitions into out (replacing it). On failure error names the line or record.
+bool LoadPartitions(const string& path, vector<Partition>& out, string& error,
+                    FileAccess mode = FileAccess::Mapped);
+
+// Parses pin coordinates into out (replacing it)
+bool LoadPins(const string& path, vector<Point>& out, string& error,
+              FileAccess mode = FileAccess::Mapped);
+
+// Writers for the formats above (binary when binary is set); false if the file cannot be written
+bool SavePartitions(const string& path, const vector<Partition>& partitions, bool binary);
+bool SavePins(const string& path, const vector<Point>& pins, bool binary);
+
+// ---- Workloads ----
+
+enum class WorkloadOp { RectQuery, NetIntersect, SearchPoint, InsertPoint, DeletePoint, NearestPoints, RadiusQuery };
+
+struct WorkloadQuery {
+    WorkloadOp op;
+    int a, b, c, d;  // Coordinates / k / radius in command order
+};
+
+// What RunWorkload did
+struct WorkloadReport {
+    size_t queries = 0;
+    size_t results = 0;          // Partition IDs / points written
+    double seconds = 0;          // Query time, output formatting included
+    size_t perOp[7] = {0};       // Queries of each WorkloadOp
+};
+
+// Parses a workload file into queries (replacing them), so parsing stays out of the timed run
+bool LoadWorkload(const string& path, vector<WorkloadQuery>& out, string& error,
+                  FileAccess mode = FileAccess::Mapped);
+
+// Runs the queries in order against tree and writes one line per query to out:
+//   RectQuery / NetIntersect   partition IDs (ChannelGraph vertex indices)
+//   SearchPoint                leaf ID, ':' and the partition IDs holding the point
+//   InsertPoint / DeletePoint  leaf ID, or "-" when the point was not stored/found
+//   NearestPoints / RadiusQuery  x,y pairs
+// With a cache attached to tree, RectQuery, NetIntersect and SearchPoint go through it.
+WorkloadReport RunWorkload(QuadtreeNode& tree, const vector<WorkloadQuery>& queries, ostream& out,
+                           QueryCache* cache = nullptr);
+
+#endif
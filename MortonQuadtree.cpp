@@ -0,0 +1,138 @@
+#include "MortonQuadtree.h"
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+MortonQuadtree::MortonQuadtree() : root(nullptr), depth(0), builtVersion(0), originX(0), originY(0) {}
+
+// ================= Bit interleave ===========================
+
+uint64_t MortonQuadtree::Interleave(uint32_t column, uint32_t row) {
+#ifdef __BMI2__
+    return _pdep_u64(column, 0xAAAAAAAAAAAAAAAAull) | _pdep_u64(row, 0x5555555555555555ull);
+#else
+    auto spread = [](uint64_t v) {
+        v &= 0xFFFFFFFFull;
+        v = (v | (v << 16)) & 0x0000FFFF0000FFFFull;
+        v = (v | (v << 8)) & 0x00FF00FF00FF00FFull;
+        v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0Full;
+        v = (v | (v << 2)) & 0x3333333333333333ull;
+        v = (v | (v << 1)) & 0x5555555555555555ull;
+        return v;
+    };
+    return (spread(column) << 1) | spread(row);
+#endif
+}
+
+// ================= Build ====================================
+
+// Replays Subdivide's split along one axis (the lower child gets (len + 1) / 2)
+// level by level, keeping the far border of every span. Spans are split in
+// place from the back; a span starts where the one before it ends.
+void MortonQuadtree::BuildAxis(int length, int depth, vector<int>& ends) {
+    ends.assign(size_t(1) << depth, length);
+    for (size_t count = 1; count < ends.size(); count *= 2) {
+        for (size_t i = count; i-- > 0;) {
+            int start = i ? ends[i - 1] : 0, end = ends[i];
+            int len = end - start;
+            ends[2 * i] = start + (len - len / 2);
+            ends[2 * i + 1] = end;
+        }
+    }
+}
+
+// Column (or row) holding offset: the first span whose far border is not
+// below it, so a point on a shared border goes to the lower child, as the
+// first-match InBoundary scan in SearchPoint does
+bool MortonQuadtree::AxisIndex(const vector<int>& ends, long long offset, uint32_t& index) {
+    if (offset < 0 || offset > ends.back()) return false;
+    index = (uint32_t)(lower_bound(ends.begin(), ends.end(), offset) - ends.begin());
+    return true;
+}
+
+// Walks the tree, deriving each node's code from its child slot (slot = column * 2 + row)
+bool MortonQuadtree::Collect(QuadtreeNode* node, int level, uint64_t code, string& error) {
+    idByLevel[level][code] = node->GetID();
+    const auto& children = node->GetChildren();
+    if (children.empty()) {
+        if (level != depth) {
+            error = "leaves are not all at the same level";
+            return false;
+        }
+        leafByCode[code] = node;
+        return true;
+    }
+    if (children.size() != 4 || level == depth) {
+        error = "tree is not a uniform scale-2 subdivision";
+        return false;
+    }
+    for (uint64_t slot = 0; slot < 4; ++slot) {
+        if (!Collect(children[slot], level + 1, (code << 2) | slot, error)) return false;
+    }
+    return true;
+}
+
+bool MortonQuadtree::Build(QuadtreeNode& treeRoot, string& error) {
+    root = nullptr;
+    depth = 0;
+    for (const QuadtreeNode* node = &treeRoot; !node->GetChildren().empty(); node = node->GetChildren()[0])
+        ++depth;
+    if (depth > 15) {
+        error = "tree too deep for a Morton index";
+        return false;
+    }
+
+    const Vertex& r = treeRoot.getRegion();
+    originX = r.x;
+    originY = r.y;
+    BuildAxis(r.width, depth, columnEnd);
+    BuildAxis(r.height, depth, rowEnd);
+
+    leafByCode.assign(size_t(1) << (2 * depth), nullptr);
+    idByLevel.assign(depth + 1, vector<int>());
+    for (int l = 0; l <= depth; ++l) idByLevel[l].assign(size_t(1) << (2 * l), 0);
+    if (!Collect(&treeRoot, 0, 0, error)) {
+        leafByCode.clear();
+        idByLevel.clear();
+        return false;
+    }
+    root = &treeRoot;
+    builtVersion = treeRoot.ShapeVersion();
+    return true;
+}
+
+// ================= Lookups ==================================
+
+bool MortonQuadtree::Code(int x, int y, uint64_t& code) const {
+    if (!root) return false;
+    uint32_t column, row;
+    if (!AxisIndex(columnEnd, (long long)x - originX, column) ||
+        !AxisIndex(rowEnd, (long long)y - originY, row)) return false;
+    code = Interleave(column, row);
+    return true;
+}
+
+QuadtreeNode* MortonQuadtree::LocateLeaf(int x, int y) const {
+    uint64_t code;
+    return Code(x, y, code) ? leafByCode[code] : nullptr;
+}
+
+bool MortonQuadtree::PathToRoot(int x, int y, vector<int>& path) const {
+    uint64_t code;
+    if (!Code(x, y, code)) return false;
+    for (int l = 0; l <= depth; ++l)
+        path.push_back(idByLevel[l][code >> (2 * (depth - l))]);
+    return true;
+}
+
+PointResult MortonQuadtree::InsertPoint(int x, int y) {
+    QuadtreeNode* leaf = LocateLeaf(x, y);
+    if (!leaf) return PointResult();  // OutsideBoundary
+    PointResult result = leaf->InsertPoint(x, y);
+    // The leaf's own walk starts at the leaf; prefix the path from the code
+    vector<int> path;
+    PathToRoot(x, y, path);
+    path.insert(path.end(), result.path.begin() + 1, result.path.end());
+    result.path.swap(path);
+    return result;
+}
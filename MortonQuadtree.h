@@ -0,0 +1,60 @@
+#ifndef MORTON_QUADTREE_H
+#define MORTON_QUADTREE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Quadtree.h"
+
+using namespace std;
+
+// Linear (Morton / Z-order) index over a uniformly subdivided scale-2 tree.
+// Every leaf is keyed by interleaving its column and row bits, so locating the
+// leaf of a point is two binary searches over the leaf borders plus a bit
+// interleave instead of a walk from the root. Memory is O(leaves), whatever
+// the region's extent. Ancestors are found by shifting the code right.
+// The index points into the tree it was built from; it is only valid while
+// IsCurrent (no rebuild, point split or merge since Build). Reset it before
+// the tree is deleted.
+class MortonQuadtree {
+private:
+    QuadtreeNode* root;
+    int depth;                          // Level of every leaf
+    unsigned builtVersion;              // root->ShapeVersion() when built
+    int originX, originY;
+    vector<int> columnEnd, rowEnd;      // Far border (offset from the origin) of each leaf column/row
+    vector<QuadtreeNode*> leafByCode;   // 4^depth leaves, indexed by Morton code
+    vector<vector<int>> idByLevel;      // idByLevel[l][code >> 2 * (depth - l)] = node ID
+
+    static void BuildAxis(int length, int depth, vector<int>& ends);
+    static bool AxisIndex(const vector<int>& ends, long long offset, uint32_t& index);
+    bool Collect(QuadtreeNode* node, int level, uint64_t code, string& error);
+
+public:
+    MortonQuadtree();
+
+    // Indexes the tree below root. Fails (with a reason) unless every internal
+    // node has exactly 4 children and all leaves sit at the same level.
+    bool Build(QuadtreeNode& treeRoot, string& error);
+
+    bool IsBuilt() const { return root != nullptr; }
+    bool IsCurrent() const { return root && root->ShapeVersion() == builtVersion; }
+    int Depth() const { return depth; }
+
+    // Interleaves column and row bits (column bit first at every level); uses BMI2 pdep when available
+    static uint64_t Interleave(uint32_t column, uint32_t row);
+
+    // Morton code of the leaf holding (x, y); false if the point is outside the root
+    bool Code(int x, int y, uint64_t& code) const;
+
+    // Leaf holding (x, y), or nullptr if the point is outside the root
+    QuadtreeNode* LocateLeaf(int x, int y) const;
+
+    // Node IDs from the root down to the leaf holding (x, y), derived from the code
+    bool PathToRoot(int x, int y, vector<int>& path) const;
+
+    // Inserts (x, y) straight into its leaf
+    PointResult InsertPoint(int x, int y);
+};
+
+#endif
@@ -1,5 +1,12 @@
 #include "Quadtree.h"
+#include "QueryCache.h"
 #include <sstream>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+#include <queue>
+#include <climits>
 
 // ======================= DOT Visualization ==========================
 
@@ -45,46 +52,124 @@ const vector<QuadtreeNode*>& QuadtreeNode::GetLeafNodes() const {
 
 // Creates a node with specified region and graph reference
 QuadtreeNode::QuadtreeNode(const Vertex& r, ChannelGraph* g)
-    : region(r), graphPtr(g), parent(nullptr), id(currentID++) {}
+    : region(r), parent(nullptr), id(currentID++), graphPtr(g), compactPtr(nullptr),
+      leafIndex(-1), pointCapacity(0), splitForPoints(false), partitionIndex(PartitionIndex::Leaves),
+      queryCache(nullptr), shapeVersion(0) {}
+
+// Creates a node that reads partitions from a frozen CSR graph
+QuadtreeNode::QuadtreeNode(const Vertex& r, const CompactChannelGraph* g)
+    : region(r), parent(nullptr), id(currentID++), graphPtr(nullptr), compactPtr(g),
+      leafIndex(-1), pointCapacity(0), splitForPoints(false), partitionIndex(PartitionIndex::Leaves),
+      queryCache(nullptr), shapeVersion(0) {}
+
+// Creates a node with a caller-chosen ID, leaving the shared counter untouched
+QuadtreeNode::QuadtreeNode(const Vertex& r, ChannelGraph* g, int nodeID)
+    : region(r), parent(nullptr), id(nodeID), graphPtr(g), compactPtr(nullptr),
+      leafIndex(-1), pointCapacity(0), splitForPoints(false), partitionIndex(PartitionIndex::Leaves),
+      queryCache(nullptr), shapeVersion(0) {}
 
 // Recursively deletes all child nodes
 QuadtreeNode::~QuadtreeNode() {
+    if (queryCache) queryCache->Attach(nullptr);
     for (auto* ch : children) delete ch;
 }
 
 // ================= Point-in-boundary check ===================
 
 // Returns true if point (x, y) lies within this node's region
-bool QuadtreeNode::InBoundary(int x, int y) {
+bool QuadtreeNode::InBoundary(int x, int y) const {
     return (x >= region.x && x <= region.x + region.width &&
             y >= region.y && y <= region.y + region.height);
 }
 
 // =================== Subdivision =============================
 
-// Recursively subdivides this node into smaller children
-void QuadtreeNode::Subdivide(int minW, int minH, int scale) {
-    auto& graph = *graphPtr;
+// Returns true once the region is small enough to stop subdividing
+bool QuadtreeNode::IsLeafSized(int minW, int minH) const {
+    return region.width <= minW && region.height <= minH;
+}
 
+// Keeps the partitions from parentIDs that overlap this region. A partition
+// overlapping a child always overlaps its parent, so filtering the parent's
+// list gives the same result as scanning the whole graph.
+void QuadtreeNode::FilterPartitions(const vector<int>& parentIDs, vector<int>& out) const {
     int w = region.width, h = region.height;
-
-    // Base case: small enough to stop subdividing
-    if (w <= minW && h <= minH) {
-        for (auto vertexID : boost::make_iterator_range(vertices(graph))) {
-            const Partition& partition = graph[vertexID];
-            bool overlaps = !(partition.x2 <= region.x || partition.x1 >= region.x + w ||
-                              partition.y2 <= region.y || partition.y1 >= region.y + h);
-            if (overlaps) {
-                graphPartitionIDs.push_back(vertexID);
-            }
+    for (int pid : parentIDs) {
+        Rect partition = PartitionBox(pid);
+        bool overlaps = !(partition.x2 <= region.x || partition.x1 >= region.x + w ||
+                          partition.y2 <= region.y || partition.y1 >= region.y + h);
+        if (overlaps) {
+            out.push_back(pid);
         }
+    }
+}
 
-        // Add this leaf to the root's leaf list
-        QuadtreeNode* root = this;
-        while (root->parent) root = root->parent;
-        root->leafNodes.push_back(this);
-        return;
+// Root step: every partition of the graph that overlaps this region
+vector<int> QuadtreeNode::RootPartitions() const {
+    vector<int> all(PartitionCount());
+    for (size_t pid = 0; pid < all.size(); ++pid)
+        all[pid] = (int)pid;
+    vector<int> overlapping;
+    FilterPartitions(all, overlapping);
+    return overlapping;
+}
+
+// A region is uniform when it is all free (no partitions) or lies entirely
+// inside a single partition, so splitting it further adds nothing
+bool QuadtreeNode::IsUniform(const vector<int>& ids) const {
+    if (ids.empty()) return true;
+    if (ids.size() != 1) return false;
+    Rect p = PartitionBox(ids[0]);
+    return p.x1 <= region.x && p.x2 >= region.x + region.width &&
+           p.y1 <= region.y && p.y2 >= region.y + region.height;
+}
+
+// Leaf test shared by the serial and parallel builds
+bool QuadtreeNode::StopsAt(int minW, int minH, bool stopWhenUniform, const vector<int>& ids) const {
+    return IsLeafSized(minW, minH) || (stopWhenUniform && IsUniform(ids));
+}
+
+// Enclosing index: the smallest node whose closed region holds p (first child
+// wins on shared borders). The root also owns partitions reaching outside it.
+bool QuadtreeNode::Owns(const Rect& p) const {
+    if (parent && !ContainsBox(p.x1, p.y1, p.x2, p.y2)) return false;
+    for (auto* ch : children)
+        if (ch->ContainsBox(p.x1, p.y1, p.x2, p.y2)) return false;
+    return true;
+}
+
+// Called with the partitions overlapping this node once its children exist (or
+// it stays a leaf). The leaf index moves the whole list into a leaf; the
+// enclosing index copies the owned ones out and leaves ids for the children.
+void QuadtreeNode::StorePartitions(vector<int>& ids) {
+    if (partitionIndex == PartitionIndex::Leaves) {
+        if (children.empty()) graphPartitionIDs = std::move(ids);
+    } else {
+        graphPartitionIDs.clear();
+        for (int pid : ids)
+            if (Owns(PartitionBox(pid))) graphPartitionIDs.push_back(pid);
+    }
+    PackBoxes();
+}
+
+// Copies the stored partitions' boxes into one allocation, a column per
+// coordinate, so the query kernels read them contiguously
+void QuadtreeNode::PackBoxes() {
+    size_t n = graphPartitionIDs.size();
+    packedBoxes.resize(4 * n);
+    for (size_t k = 0; k < n; ++k) {
+        Rect p = PartitionBox(graphPartitionIDs[k]);
+        packedBoxes[k] = p.x1;
+        packedBoxes[n + k] = p.y1;
+        packedBoxes[2 * n + k] = p.x2;
+        packedBoxes[3 * n + k] = p.y2;
     }
+}
+
+// Splits the region into scale x scale children; IDs are only drawn from the
+// shared counter when assignIds is set (parallel builds number nodes afterwards)
+void QuadtreeNode::CreateChildren(int scale, bool assignIds) {
+    int w = region.width, h = region.height;
 
     // Compute dimensions of child nodes
     int subWidth = (w + scale - 1) / scale;
@@ -104,190 +189,1075 @@ void QuadtreeNode::Subdivide(int minW, int minH, int scale) {
             int actualHeight = std::min(subHeight, parentY + h - childY);
 
             if (actualWidth > 0 && actualHeight > 0) {
-                auto* childNode = new QuadtreeNode(Vertex(childX, childY, actualWidth, actualHeight, nextLevel), graphPtr);
+                Vertex childRegion(childX, childY, actualWidth, actualHeight, nextLevel);
+                auto* childNode = assignIds ? new QuadtreeNode(childRegion, graphPtr)
+                                            : new QuadtreeNode(childRegion, graphPtr, 0);
                 childNode->parent = this;
+                childNode->compactPtr = compactPtr;
+                childNode->pointCapacity = pointCapacity;
+                childNode->partitionIndex = partitionIndex;
                 children.push_back(childNode);
             }
         }
     }
+}
+
+// Recursively subdivides this node into smaller children
+void QuadtreeNode::Subdivide(int minW, int minH, int scale, bool stopWhenUniform) {
+    NotifyChange(TreeChange::Rebuilt, ClosedRegion());
+    vector<int> ids = RootPartitions();
+    SubdivideWith(minW, minH, scale, stopWhenUniform, ids);
+}
+
+// Subdivision step: ids holds the partitions overlapping this node, children
+// only filter that list instead of rescanning the graph
+void QuadtreeNode::SubdivideWith(int minW, int minH, int scale, bool stopWhenUniform, vector<int>& ids) {
+    // Base case: small enough (or uniform) to stop subdividing
+    if (StopsAt(minW, minH, stopWhenUniform, ids)) {
+        StorePartitions(ids);
+
+        // Add this leaf to the root's leaf list
+        Root()->AddLeaf(this);
+        return;
+    }
+
+    CreateChildren(scale, true);
+    StorePartitions(ids);
 
     // Recurse further
     for (auto* child : children) {
-        child->Subdivide(minW, minH, scale);
+        vector<int> childIDs;
+        child->FilterPartitions(ids, childIDs);
+        child->SubdivideWith(minW, minH, scale, stopWhenUniform, childIDs);
     }
 }
 
-// ================ Insert Point ==============================
-// Inserts a point into the quadtree, placing it in the correct leaf
-void QuadtreeNode::InsertPoint(int x, int y) {
-    if (!this->InBoundary(x, y)) {
-        cout << "Point (" << x << "," << y << ") is outside the root boundary. Cannot insert.\n";
+// ============== Parallel Subdivision ========================
+
+// Builds the subtree below this node without touching shared state (IDs, leaf list)
+void QuadtreeNode::BuildSubtree(int minW, int minH, int scale, bool stopWhenUniform, vector<int>& ids) {
+    if (StopsAt(minW, minH, stopWhenUniform, ids)) {
+        StorePartitions(ids);
         return;
     }
+    CreateChildren(scale, false);
+    StorePartitions(ids);
+    for (auto* child : children) {
+        vector<int> childIDs;
+        child->FilterPartitions(ids, childIDs);
+        child->BuildSubtree(minW, minH, scale, stopWhenUniform, childIDs);
+    }
+}
+
+// Gives children IDs in the same order the serial Subdivide creates them:
+// all children of a node first, then each child's subtree in turn
+void QuadtreeNode::NumberChildren() {
+    for (auto* child : children) child->id = currentID++;
+    for (auto* child : children) child->NumberChildren();
+}
 
+// Appends the leaves below this node in depth-first order
+void QuadtreeNode::CollectLeaves(vector<QuadtreeNode*>& out) {
     if (children.empty()) {
-        points.emplace_back(x, y);
-        cout << "Inserted at node " << id << "\n";
+        out.push_back(this);
         return;
     }
-    for (auto* ch : children) {
-        if (ch && ch->InBoundary(x, y)) {
-            ch->InsertPoint(x, y);
-            return;
+    for (auto* child : children) child->CollectLeaves(out);
+}
+
+// Same tree as Subdivide, built by expanding the top levels serially and then
+// handing the resulting subtrees to worker threads. IDs and leaf order are
+// assigned afterwards so the result is identical to the serial build.
+void QuadtreeNode::SubdivideParallel(int minW, int minH, int scale, int threads, bool stopWhenUniform) {
+    if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+    if (threads <= 0) threads = 1;
+    NotifyChange(TreeChange::Rebuilt, ClosedRegion());
+
+    // Expand breadth-first until there are enough independent subtrees,
+    // carrying each frontier node's filtered partition list along
+    vector<QuadtreeNode*> frontier{this};
+    vector<vector<int>> frontierIDs{RootPartitions()};
+    size_t target = (size_t)threads * 8;
+    bool expanded = true;
+    while (frontier.size() < target && expanded) {
+        expanded = false;
+        vector<QuadtreeNode*> next;
+        vector<vector<int>> nextIDs;
+        for (size_t f = 0; f < frontier.size(); ++f) {
+            QuadtreeNode* node = frontier[f];
+            if (node->StopsAt(minW, minH, stopWhenUniform, frontierIDs[f])) {
+                next.push_back(node);
+                nextIDs.push_back(std::move(frontierIDs[f]));
+                continue;
+            }
+            node->CreateChildren(scale, false);
+            node->StorePartitions(frontierIDs[f]);
+            for (auto* child : node->children) {
+                next.push_back(child);
+                nextIDs.emplace_back();
+                child->FilterPartitions(frontierIDs[f], nextIDs.back());
+            }
+            expanded = true;
+        }
+        frontier.swap(next);
+        frontierIDs.swap(nextIDs);
+    }
+
+    // Workers pull subtrees from a shared index until all are built
+    std::atomic<size_t> nextTask(0);
+    auto worker = [&]() {
+        for (size_t t = nextTask++; t < frontier.size(); t = nextTask++)
+            frontier[t]->BuildSubtree(minW, minH, scale, stopWhenUniform, frontierIDs[t]);
+    };
+    vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& th : pool) th.join();
+
+    NumberChildren();
+    CollectLeaves(leafNodes);
+    for (size_t i = 0; i < leafNodes.size(); ++i) leafNodes[i]->leafIndex = (int)i;
+}
+
+// ================ Logging ===================================
+
+// Diagnostics sink; the message is only formatted when a logger is installed,
+// and QUADTREE_NO_LOGGING removes the call sites entirely
+std::function<void(const string&)> QuadtreeNode::logger;
+
+void QuadtreeNode::SetLogger(std::function<void(const string&)> sink) {
+    logger = std::move(sink);
+}
+
+#ifdef QUADTREE_NO_LOGGING
+#define QUADTREE_LOG(message) ((void)0)
+#else
+#define QUADTREE_LOG(message)                         \
+    do {                                              \
+        if (QuadtreeNode::logger) {                   \
+            std::ostringstream logStream;             \
+            logStream << message;                     \
+            QuadtreeNode::logger(logStream.str());    \
+        }                                             \
+    } while (0)
+#endif
+
+// ================ Point descent =============================
+// Walks from this node to the leaf holding (x, y), first matching child wins.
+// Records the path and the last node reached in result; returns nullptr when
+// the point is outside this node or no child covers it.
+const QuadtreeNode* QuadtreeNode::Descend(int x, int y, PointResult& result) const {
+    if (!InBoundary(x, y)) {
+        result.status = PointStatus::OutsideBoundary;
+        return nullptr;
+    }
+    const QuadtreeNode* node = this;
+    result.path.push_back(node->id);
+    while (!node->children.empty()) {
+        const QuadtreeNode* next = nullptr;
+        for (auto* ch : node->children) {
+            if (ch->InBoundary(x, y)) {
+                next = ch;
+                break;
+            }
+        }
+        if (!next) break;
+        node = next;
+        result.path.push_back(node->id);
+    }
+    const Vertex& r = node->region;
+    result.leafID = node->id;
+    result.region = {r.x, r.y, r.x + r.width, r.y + r.height};
+    result.status = node->children.empty() ? PointStatus::Ok : PointStatus::NoLeaf;
+    return node->children.empty() ? node : nullptr;
+}
+
+// ================ Insert Point ==============================
+// Inserts a point into the quadtree, placing it in the correct leaf
+PointResult QuadtreeNode::InsertPoint(int x, int y) {
+    PointResult result;
+    QuadtreeNode* leaf = const_cast<QuadtreeNode*>(Descend(x, y, result));
+    if (!leaf) {
+        QUADTREE_LOG("InsertPoint (" << x << "," << y << "): no leaf covers the point");
+        return result;
+    }
+
+    leaf->points.emplace_back(x, y);
+    if (leaf->pointCapacity > 0 && (int)leaf->points.size() > leaf->pointCapacity) {
+        leaf->SplitForPoints();
+        // The point moved into one of the new children, so finish the walk there
+        if (!leaf->children.empty()) {
+            NotifyChange(TreeChange::Leaves, leaf->ClosedRegion());
+            result.path.pop_back();
+            leaf->Descend(x, y, result);
+            QUADTREE_LOG("InsertPoint: node " << leaf->id << " split above " << leaf->pointCapacity << " points");
         }
     }
-    cout << "Point (" << x << "," << y << ") is outside all current leaf nodes. Cannot insert.\n";
+    return result;
 }
 
 // ================ Search Point ==============================
-// Finds the node containing a point and prints the path followed
-void QuadtreeNode::SearchPoint(int x, int y, std::vector<int>& path) {
-    if (!this->InBoundary(x, y)) {
-        cout << "Point (" << x << "," << y << ") is outside this boundary.\n";
-        return;
+// Finds the leaf containing a point and the partitions that hold it
+PointResult QuadtreeNode::SearchPoint(int x, int y) const {
+    PointResult result;
+    const QuadtreeNode* leaf = Descend(x, y, result);
+    if (!leaf) {
+        QUADTREE_LOG("SearchPoint (" << x << "," << y << "): no leaf covers the point");
+        return result;
     }
-    path.push_back(this->id);
-    // If this is a leaf node
-    if (this->children.empty()) {
-        cout << "Node ID " << id << " region (" << region.x << "," << region.y << ") "
-             << region.width << "x" << region.height << "\nPartitions: ";
-        bool foundPartition = false;
-        for (int pid : graphPartitionIDs) {
-            const Partition& p = (*graphPtr)[pid];
-            if (x >= p.x1 && x <= p.x2 && y >= p.y1 && y <= p.y2) {
-                cout << p.name << " ";
-                foundPartition = true;
+    // With the enclosing index the nodes above the leaf hold partitions too
+    static thread_local vector<int> hits;
+    for (const QuadtreeNode* node = leaf; node != parent; node = node->parent) {
+        int n = (int)node->graphPartitionIDs.size();
+        if (!n) continue;
+        if ((int)hits.size() < n) hits.resize(n);
+        int count = PointInBoxes(x, y, node->BoxColumn(0), node->BoxColumn(1), node->BoxColumn(2), node->BoxColumn(3),
+                                 n, hits.data());
+        for (int k = 0; k < count; ++k) result.partitions.push_back(node->graphPartitionIDs[hits[k]]);
+    }
+    if (partitionIndex == PartitionIndex::Enclosing) sort(result.partitions.begin(), result.partitions.end());
+    return result;
+}
+// ================ Locate Partition ==========================
+int QuadtreeNode::LocatePartition(int x, int y) const {
+    if (!InBoundary(x, y)) return -1;
+    const QuadtreeNode* node = this;
+    while (!node->children.empty()) {
+        const QuadtreeNode* next = nullptr;
+        for (auto* ch : node->children) {
+            if (ch->InBoundary(x, y)) {
+                next = ch;
+                break;
+            }
+        }
+        if (!next) return -1;
+        node = next;
+    }
+    // Lowest matching ID along the path (lists are sorted, so the first hit per node)
+    int found = -1;
+    for (; node != parent; node = node->parent) {
+        const int *x1 = node->BoxColumn(0), *y1 = node->BoxColumn(1), *x2 = node->BoxColumn(2), *y2 = node->BoxColumn(3);
+        for (size_t k = 0; k < node->graphPartitionIDs.size(); ++k) {
+            if (x >= x1[k] && x <= x2[k] && y >= y1[k] && y <= y2[k]) {
+                int pid = node->graphPartitionIDs[k];
+                if (found < 0 || pid < found) found = pid;
+                break;
             }
         }
-        if (!foundPartition) cout << "None";
+    }
+    return found;
+}
 
-        cout << "\nPath: ";
-        for (size_t i = 0; i < path.size(); ++i)
-            cout << path[i] << (i != path.size() - 1 ? " -> " : "");
-        cout << "\n";
-        return;
+// ================ Bulk Insert ===============================
+
+// Runs body(begin, end, t) on threads contiguous slices of [0, n)
+static void ForEachSlice(size_t n, int threads, const std::function<void(size_t, size_t, int)>& body) {
+    vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(body, n * t / threads, n * (t + 1) / threads, t);
+    body(0, n / threads, 0);
+    for (auto& th : pool) th.join();
+}
+
+// Radix-partitions data[0, n) among the children (same first-match rule as
+// InsertPoint), scattering into tmp, and recurses with the buffers swapped.
+// Leaves append their whole run at once. Returns the points that reached a leaf.
+size_t QuadtreeNode::DistributePoints(pair<int, int>* data, pair<int, int>* tmp, size_t n) {
+    if (n == 0) return 0;
+    if (children.empty()) {
+        points.reserve(points.size() + n);
+        points.insert(points.end(), data, data + n);
+        return n;
     }
-    // If not a leaf, search children
-    for (auto* ch : children) {
-        if (ch && ch->InBoundary(x, y)) {
-            ch->SearchPoint(x, y, path);
-            return;
+
+    // Child boxes copied out once so the per-point loops stay in registers/L1
+    size_t k = children.size();  // bucket k holds points no child covers
+    vector<Rect> box(k);
+    for (size_t c = 0; c < k; ++c) {
+        const Vertex& r = children[c]->region;
+        box[c] = {r.x, r.y, r.x + r.width, r.y + r.height};
+    }
+    // A 2x2 split (children in i-major order) reduces to two comparisons against
+    // the first child's far edges, border points going to the lower child as in
+    // InsertPoint. Other layouts test every box and keep the lowest hit, with no
+    // early exit to mispredict on random input.
+    bool quad = k == 4 && box[1].x1 == box[0].x1 && box[2].y1 == box[0].y1 &&
+                box[3].x1 == box[2].x1 && box[3].y1 == box[1].y1;
+    auto childOf = [&](const pair<int, int>& pt) {
+        if (quad) return (size_t)((pt.first > box[0].x2) * 2 + (pt.second > box[0].y2));
+        size_t first = k;
+        for (size_t c = k; c-- > 0;) {
+            bool inside = (pt.first >= box[c].x1) & (pt.first <= box[c].x2) &
+                          (pt.second >= box[c].y1) & (pt.second <= box[c].y2);
+            first = inside ? c : first;
+        }
+        return first;
+    };
+    vector<size_t> offset(k + 2, 0);
+    for (size_t i = 0; i < n; ++i) ++offset[childOf(data[i]) + 1];
+    for (size_t c = 1; c <= k + 1; ++c) offset[c] += offset[c - 1];
+    vector<size_t> next(offset.begin(), offset.end() - 1);
+    for (size_t i = 0; i < n; ++i) tmp[next[childOf(data[i])]++] = data[i];
+
+    size_t placed = 0;
+    for (size_t c = 0; c < k; ++c)
+        placed += children[c]->DistributePoints(tmp + offset[c], data + offset[c], offset[c + 1] - offset[c]);
+    return placed;
+}
+
+// The top of the tree is flattened into a small table and every point is routed
+// through it to one of a few hundred subtrees (counting sort, per-thread counts).
+// Worker threads then radix-partition each subtree's run down to its leaves, so
+// points stream through memory instead of each walking from the root. Only the
+// capacity splits at the end are serial.
+size_t QuadtreeNode::BulkInsertPoints(const vector<Point>& pts, int threads) {
+    size_t n = pts.size();
+    if (n == 0) return 0;
+    if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+    if (threads <= 0) threads = 1;
+    threads = (int)std::min<size_t>(threads, std::max<size_t>(1, n / 4096));
+
+    // Expand breadth-first until there are enough subtrees to share out
+    struct TopNode {
+        QuadtreeNode* node;
+        Rect box;                    // Closed region, copied so routing stays in the table
+        int firstChild, childCount;  // entries in top, when expanded
+        int bucket;                  // subtree index, or -1 when expanded
+    };
+    auto entry = [](QuadtreeNode* node) {
+        const Vertex& r = node->region;
+        return TopNode{node, {r.x, r.y, r.x + r.width, r.y + r.height}, 0, 0, -1};
+    };
+    vector<TopNode> top{entry(this)};
+    vector<QuadtreeNode*> subtrees;
+    vector<int> current{0};
+    size_t target = (size_t)threads * 64;
+    while (!current.empty()) {
+        bool expand = subtrees.size() + current.size() < target;
+        vector<int> next;
+        for (int t : current) {
+            QuadtreeNode* node = top[t].node;
+            if (!expand || node->children.empty()) {
+                top[t].bucket = (int)subtrees.size();
+                subtrees.push_back(node);
+                continue;
+            }
+            top[t].firstChild = (int)top.size();
+            top[t].childCount = (int)node->children.size();
+            for (auto* ch : node->children) {
+                next.push_back((int)top.size());
+                top.push_back(entry(ch));
+            }
+        }
+        current.swap(next);
+    }
+    size_t bucketCount = subtrees.size();  // bucket bucketCount collects points outside the tree
+
+    vector<int> bucketOf(n);
+    vector<vector<size_t>> counts(threads, vector<size_t>(bucketCount + 1, 0));
+    ForEachSlice(n, threads, [&](size_t begin, size_t end, int t) {
+        vector<size_t>& count = counts[t];
+        for (size_t i = begin; i < end; ++i) {
+            int x = pts[i].x, y = pts[i].y;
+            auto inside = [&](int e) {
+                const Rect& b = top[e].box;
+                return (x >= b.x1) & (x <= b.x2) & (y >= b.y1) & (y <= b.y2);
+            };
+            int e = inside(0) ? 0 : -1;
+            while (e >= 0 && top[e].bucket < 0) {
+                int first = -1;
+                for (int c = top[e].firstChild + top[e].childCount; c-- > top[e].firstChild;)
+                    first = inside(c) ? c : first;
+                e = first;
+            }
+            int key = e < 0 ? (int)bucketCount : top[e].bucket;
+            bucketOf[i] = key;
+            ++count[key];
+        }
+    });
+
+    // Bucket-major, thread-minor prefix sums keep input order within each bucket
+    vector<size_t> bucketBegin(bucketCount + 2);
+    size_t pos = 0;
+    for (size_t b = 0; b <= bucketCount; ++b) {
+        bucketBegin[b] = pos;
+        for (int t = 0; t < threads; ++t) {
+            size_t c = counts[t][b];
+            counts[t][b] = pos;
+            pos += c;
+        }
+    }
+    bucketBegin[bucketCount + 1] = pos;
+
+    vector<pair<int, int>> sorted(n), tmp(n);
+    ForEachSlice(n, threads, [&](size_t begin, size_t end, int t) {
+        vector<size_t>& next = counts[t];
+        for (size_t i = begin; i < end; ++i) sorted[next[bucketOf[i]]++] = {pts[i].x, pts[i].y};
+    });
+
+    // Subtrees are disjoint, so workers can fill them independently
+    std::atomic<size_t> nextTask(0), placed(0);
+    ForEachSlice(bucketCount, threads, [&](size_t, size_t, int) {
+        size_t mine = 0;
+        for (size_t b = nextTask++; b < bucketCount; b = nextTask++) {
+            size_t from = bucketBegin[b];
+            mine += subtrees[b]->DistributePoints(sorted.data() + from, tmp.data() + from, bucketBegin[b + 1] - from);
         }
+        placed += mine;
+    });
+
+    // Splitting edits leafNodes, so pick the over-full leaves first
+    vector<QuadtreeNode*> single{this};
+    const vector<QuadtreeNode*>& leaves = children.empty() ? single : leafNodes;
+    vector<QuadtreeNode*> overFull;
+    for (auto* leaf : leaves)
+        if (leaf->pointCapacity > 0 && (int)leaf->points.size() > leaf->pointCapacity) overFull.push_back(leaf);
+    for (auto* leaf : overFull) {
+        leaf->SplitForPoints();
+        if (!leaf->children.empty()) NotifyChange(TreeChange::Leaves, leaf->ClosedRegion());
     }
-    // Fallback: No child covers the point, so print this parent node as the last valid region
-    cout << "No leaf node contains (" << x << "," << y << "). Nearest region:\n";
-    cout << "Node ID " << id << " region (" << region.x << "," << region.y << ") "
-         << region.width << "x" << region.height << "\n";
 
-    cout << "Path: ";
-    for (size_t i = 0; i < path.size(); ++i)
-        cout << path[i] << (i != path.size() - 1 ? " -> " : "");
-    cout << "\n";
+    return placed;
 }
+
 // =================== Delete Point ============================
-// Removes a point and deletes the corresponding leaf node
-void QuadtreeNode::DeletePoint(int x, int y) {
-    if (!this->InBoundary(x, y)) {
-        cout << "Point (" << x << "," << y << ") does not lie inside the tree.\n";
-        return;
+// Removes one stored point; the leaf itself stays in the tree
+PointResult QuadtreeNode::DeletePoint(int x, int y) {
+    PointResult result;
+    QuadtreeNode* leaf = const_cast<QuadtreeNode*>(Descend(x, y, result));
+    if (!leaf) {
+        QUADTREE_LOG("DeletePoint (" << x << "," << y << "): no leaf covers the point");
+        return result;
+    }
+
+    auto it = find(leaf->points.begin(), leaf->points.end(), make_pair(x, y));
+    if (it == leaf->points.end()) {
+        result.status = PointStatus::NotFound;
+        return result;
     }
+    *it = leaf->points.back();
+    leaf->points.pop_back();
+    // May delete the leaf, so it must not be touched afterwards
+    if (leaf->parent) leaf->parent->MergeAfterDelete();
+    return result;
+}
+
+// ================ Leaf bookkeeping ==========================
+
+QuadtreeNode* QuadtreeNode::Root() {
+    QuadtreeNode* root = this;
+    while (root->parent) root = root->parent;
+    return root;
+}
+
+void QuadtreeNode::NotifyChange(TreeChange change, const Rect& changed) {
+    QuadtreeNode* root = Root();
+    if (change != TreeChange::Partitions) ++root->shapeVersion;
+    if (root->queryCache) root->queryCache->Invalidate(change, changed);
+}
+
+void QuadtreeNode::AddLeaf(QuadtreeNode* leaf) {
+    leaf->leafIndex = (int)leafNodes.size();
+    leafNodes.push_back(leaf);
+}
+
+// Moves the last leaf into the removed slot instead of shifting the list
+void QuadtreeNode::RemoveLeaf(QuadtreeNode* leaf) {
+    int i = leaf->leafIndex;
+    if (i < 0 || i >= (int)leafNodes.size() || leafNodes[i] != leaf) return;
+    leafNodes[i] = leafNodes.back();
+    leafNodes[i]->leafIndex = i;
+    leafNodes.pop_back();
+    leaf->leafIndex = -1;
+}
+
+// ================ Adaptive split / merge ====================
 
-    if (this->children.empty()) {
-        auto it = find(leafNodes.begin(), leafNodes.end(), this);
-        if (it != leafNodes.end()) leafNodes.erase(it);
+void QuadtreeNode::SetPointCapacity(int capacity) {
+    pointCapacity = capacity;
+    for (auto* ch : children) ch->SetPointCapacity(capacity);
+}
+
+// Splits an over-full leaf into 2x2 children that share out its partitions and
+// points; a 1x1 region cannot split, so duplicates stay together
+void QuadtreeNode::SplitForPoints() {
+    if (region.width <= 1 && region.height <= 1) return;
 
-        if (this->parent) {
-            auto& siblings = this->parent->children;
-            siblings.erase(remove(siblings.begin(), siblings.end(), this), siblings.end());
+    QuadtreeNode* root = Root();
+    root->RemoveLeaf(this);
+    CreateChildren(2, true);
+    for (auto* ch : children) {
+        ch->splitForPoints = true;
+        if (partitionIndex == PartitionIndex::Leaves) ch->FilterPartitions(graphPartitionIDs, ch->graphPartitionIDs);
+        root->AddLeaf(ch);
+    }
+    if (partitionIndex == PartitionIndex::Leaves) {
+        graphPartitionIDs.clear();
+    } else {
+        // Partitions a child holds move down to it, the rest stay here
+        vector<int> kept;
+        for (int pid : graphPartitionIDs) {
+            Rect p = PartitionBox(pid);
+            QuadtreeNode* owner = this;
+            for (auto* ch : children) {
+                if (ch->ContainsBox(p.x1, p.y1, p.x2, p.y2)) {
+                    owner = ch;
+                    break;
+                }
+            }
+            (owner == this ? kept : owner->graphPartitionIDs).push_back(pid);
         }
+        graphPartitionIDs.swap(kept);
+    }
+    PackBoxes();
+    for (auto* ch : children) ch->PackBoxes();
 
-        cout << "Deleted leaf node containing (" << x << "," << y << ")\n";
-        delete this;
-        return;
+    // Same first-match rule as InsertPoint
+    for (const auto& pt : points) {
+        for (auto* ch : children) {
+            if (ch->InBoundary(pt.first, pt.second)) {
+                ch->points.push_back(pt);
+                break;
+            }
+        }
+    }
+    vector<pair<int, int>>().swap(points);
+
+    for (auto* ch : children) {
+        if ((int)ch->points.size() > pointCapacity) ch->SplitForPoints();
+    }
+}
+
+// Called on the parent of a leaf that lost a point. If all children are
+// point-split leaves holding at most half the capacity together, they fold
+// back into this node, and the check repeats one level up.
+void QuadtreeNode::MergeAfterDelete() {
+    if (pointCapacity <= 0 || children.empty()) return;
+    size_t total = 0;
+    for (auto* ch : children) {
+        if (!ch->children.empty() || !ch->splitForPoints) return;
+        total += ch->points.size();
+    }
+    if (total > (size_t)pointCapacity / 2) return;
+
+    QuadtreeNode* root = Root();
+    for (auto* ch : children) {
+        root->RemoveLeaf(ch);
+        points.insert(points.end(), ch->points.begin(), ch->points.end());
+        graphPartitionIDs.insert(graphPartitionIDs.end(), ch->graphPartitionIDs.begin(), ch->graphPartitionIDs.end());
+        delete ch;
     }
-    for (auto*& ch : children) {
-        if (ch && ch->InBoundary(x, y)) {
-            ch->DeletePoint(x, y);
-            return;
+    children.clear();
+    // Leaf index: the children's partitions together are exactly this region's.
+    // Enclosing index: theirs join the ones this node already held.
+    sort(graphPartitionIDs.begin(), graphPartitionIDs.end());
+    graphPartitionIDs.erase(unique(graphPartitionIDs.begin(), graphPartitionIDs.end()), graphPartitionIDs.end());
+    PackBoxes();
+    root->AddLeaf(this);
+    root->NotifyChange(TreeChange::Leaves, ClosedRegion());
+    QUADTREE_LOG("DeletePoint: children merged back into node " << id);
+
+    if (parent) parent->MergeAfterDelete();
+}
+
+// ================ Point queries =============================
+
+// Squared distance from (x, y) to the closest point of this node's region
+static long long DistanceToRegion(const Vertex& r, int x, int y) {
+    long long dx = max(0LL, max((long long)r.x - x, (long long)x - (r.x + r.width)));
+    long long dy = max(0LL, max((long long)r.y - y, (long long)y - (r.y + r.height)));
+    return dx * dx + dy * dy;
+}
+
+static long long SquaredDistance(const pair<int, int>& p, int x, int y) {
+    long long dx = (long long)p.first - x, dy = (long long)p.second - y;
+    return dx * dx + dy * dy;
+}
+
+// Best-first search: nodes come off the queue nearest first, and the search
+// stops once the next node is farther than the current k-th best point
+vector<pair<int, int>> QuadtreeNode::NearestPoints(int x, int y, int k) const {
+    vector<pair<int, int>> result;
+    if (k <= 0) return result;
+
+    typedef pair<long long, const QuadtreeNode*> NodeEntry;
+    priority_queue<NodeEntry, vector<NodeEntry>, greater<NodeEntry>> nodes;
+    priority_queue<pair<long long, pair<int, int>>> best;  // max-heap of the k closest so far
+    nodes.emplace(DistanceToRegion(region, x, y), this);
+
+    while (!nodes.empty()) {
+        NodeEntry top = nodes.top();
+        nodes.pop();
+        if ((int)best.size() == k && top.first > best.top().first) break;
+        const QuadtreeNode* node = top.second;
+        for (const auto& pt : node->points) {
+            long long d = SquaredDistance(pt, x, y);
+            if ((int)best.size() < k) best.emplace(d, pt);
+            else if (d < best.top().first) {
+                best.pop();
+                best.emplace(d, pt);
+            }
         }
+        for (auto* ch : node->children) nodes.emplace(DistanceToRegion(ch->region, x, y), ch);
+    }
+
+    result.resize(best.size());
+    for (size_t i = result.size(); i-- > 0;) {
+        result[i] = best.top().second;
+        best.pop();
+    }
+    return result;
+}
+
+vector<pair<int, int>> QuadtreeNode::PointsInRadius(int x, int y, int radius) const {
+    vector<pair<int, int>> result;
+    long long limit = (long long)radius * radius;
+    vector<const QuadtreeNode*> stack{this};
+    while (!stack.empty()) {
+        const QuadtreeNode* node = stack.back();
+        stack.pop_back();
+        if (DistanceToRegion(node->region, x, y) > limit) continue;
+        for (const auto& pt : node->points)
+            if (SquaredDistance(pt, x, y) <= limit) result.push_back(pt);
+        for (auto* ch : node->children) stack.push_back(ch);
+    }
+    return result;
+}
+
+size_t QuadtreeNode::PointCount() const {
+    size_t total = points.size();
+    for (auto* ch : children) total += ch->PointCount();
+    return total;
+}
+
+// ================ Tree statistics ===========================
+
+// Bucket 0 holds 0, bucket b holds [2^(b-1), 2^b)
+static void AddToHistogram(vector<size_t>& histogram, size_t count) {
+    size_t bucket = 0;
+    while (count >> bucket) ++bucket;
+    if (histogram.size() <= bucket) histogram.resize(bucket + 1, 0);
+    ++histogram[bucket];
+}
+
+void QuadtreeNode::AccumulateStats(TreeStats& stats) const {
+    ++stats.nodes;
+    size_t level = (size_t)max(0, region.level);
+    if (stats.nodesPerLevel.size() <= level) stats.nodesPerLevel.resize(level + 1, 0);
+    ++stats.nodesPerLevel[level];
+    stats.points += points.size();
+    if (children.empty()) {
+        ++stats.leaves;
+        AddToHistogram(stats.pointsHistogram, points.size());
+        AddToHistogram(stats.partitionsHistogram, graphPartitionIDs.size());
+        stats.maxPartitionsPerLeaf = max(stats.maxPartitionsPerLeaf, graphPartitionIDs.size());
     }
+    stats.partitionRefs += graphPartitionIDs.size();
+    for (auto* ch : children) ch->AccumulateStats(stats);
+}
 
-    cout << "No leaf node contains point (" << x << "," << y << "). Cannot delete.\n";
+TreeStats QuadtreeNode::GetTreeStats() const {
+    TreeStats stats;
+    AccumulateStats(stats);
+    return stats;
 }
+
 // ================ Path To Root ==============================
-// Records path from a given point to the root using SearchPoint
-void QuadtreeNode::PathToRoot(int x, int y, vector<int>& path) {
-    SearchPoint(x, y, path);
+// Records the node IDs from the root down to the leaf holding (x, y)
+PointStatus QuadtreeNode::PathToRoot(int x, int y, vector<int>& path) const {
+    PointResult result;
+    Descend(x, y, result);
+    path.insert(path.end(), result.path.begin(), result.path.end());
+    return result.status;
 }
 // ================ Rectangle Query ==========================
+
+// Per-thread dedup state for the overloads that don't take one
+static thread_local QueryScratch defaultScratch;
+
+const QueryStats& QuadtreeNode::LastQueryStats() {
+    return defaultScratch.stats;
+}
+
+// Fills out with IDs of partitions intersecting a given rectangle
+void QuadtreeNode::RectQuery(int x1, int y1, int x2, int y2, vector<int>& out, QueryScratch& scratch) const {
+    out.clear();
+    VisitRect(x1, y1, x2, y2, scratch, [&](int pid) { out.push_back(pid); });
+}
+
+void QuadtreeNode::RectQuery(int x1, int y1, int x2, int y2, vector<int>& out) const {
+    RectQuery(x1, y1, x2, y2, out, defaultScratch);
+}
+
 // Returns names of partitions intersecting a given rectangle
-vector<string> QuadtreeNode::RectQuery( int topLeftX, int topLeftY, int bottomRightX, int bottomRightY) {
-     auto& graph = *graphPtr;
-    unordered_set<string> partitionsInRectangle;
-    if (!this) return {};
-
-    int rectangle_top_left_X = min(topLeftX,bottomRightX);
-    int rectangle_top_left_Y = min(topLeftY,bottomRightY);
-    int rectangle_bottom_right_X = max(topLeftX,bottomRightX);
-    int rectangle_bottom_right_Y = max(topLeftY,bottomRightY);
- // No intersection with this node
-    if (this->region.x + this->region.width <= rectangle_top_left_X || this->region.x >= rectangle_bottom_right_X  ||
-        this->region.y + this->region.height <=  rectangle_top_left_Y || this->region.y >= rectangle_bottom_right_Y )
-        return {};
-// If this node is a leaf node (no children), check for overlapping partitions
-    if (this->children.empty()) {
-        for (int pid : this->graphPartitionIDs) {
-            const auto& partition = graph[pid];
-            bool overlap_x = max(rectangle_top_left_X , partition .x1) < min(rectangle_bottom_right_X, partition .x2);// Horizontal overlap
-            bool overlap_y = max(rectangle_top_left_Y, partition .y1) < min( rectangle_bottom_right_Y, partition .y2);// Vertical overlap
-           // If both overlaps exist, add the partition's name to the result set
-            if (overlap_x && overlap_y) partitionsInRectangle.insert(partition .name);
+vector<string> QuadtreeNode::RectQuery(int topLeftX, int topLeftY, int bottomRightX, int bottomRightY) {
+    vector<string> partitionsInRectangle;
+    VisitRect(topLeftX, topLeftY, bottomRightX, bottomRightY, defaultScratch,
+              [&](int pid) { partitionsInRectangle.push_back(PartitionName(pid)); });
+    return partitionsInRectangle;
+}
+
+// ================ Line (Net) Intersection ===================
+
+// Tests this node's packed partition boxes against the segment several at a
+// time. The returned buffer is reused by the next call on the same thread.
+const vector<int>& QuadtreeNode::NodeNetHits(int xs, int ys, int xe, int ye) const {
+    static thread_local vector<int> index, hits;
+    int n = (int)graphPartitionIDs.size();
+    if ((int)index.size() < n) index.resize(n);
+    int count = SegmentIntersectsBoxes(xs, ys, xe, ye, BoxColumn(0), BoxColumn(1), BoxColumn(2), BoxColumn(3),
+                                       n, index.data());
+    hits.resize(count);
+    for (int k = 0; k < count; ++k) hits[k] = graphPartitionIDs[index[k]];
+    return hits;
+}
+
+// Fills out with IDs of partitions that intersect the line between two points
+void QuadtreeNode::NetIntersect(int x1, int y1, int x2, int y2, vector<int>& out, QueryScratch& scratch) const {
+    out.clear();
+    VisitNet(x1, y1, x2, y2, scratch, [&](int pid) { out.push_back(pid); });
+}
+
+void QuadtreeNode::NetIntersect(int x1, int y1, int x2, int y2, vector<int>& out) const {
+    NetIntersect(x1, y1, x2, y2, out, defaultScratch);
+}
+
+// Returns partitions that intersect the line between two points
+vector<string> QuadtreeNode::NetIntersect(int x_start, int y_start, int x_end, int y_end) {
+    vector<string> partitionsOnLine;
+    VisitNet(x_start, y_start, x_end, y_end, defaultScratch,
+             [&](int pid) { partitionsOnLine.push_back(PartitionName(pid)); });
+    return partitionsOnLine;
+}
+
+// ================ Incremental partition edits ===============
+
+// Removed partitions keep their vertex; an inverted box never overlaps anything
+static const Partition removedPartition = {"", INT_MAX, INT_MAX, INT_MIN, INT_MIN};
+static const Rect removedBox = {INT_MAX, INT_MAX, INT_MIN, INT_MIN};
+
+static bool BoxOverlapsRegion(const Rect& p, const Vertex& r) {
+    return !(p.x2 <= r.x || p.x1 >= r.x + r.width || p.y2 <= r.y || p.y1 >= r.y + r.height);
+}
+
+// Leaf index: visits only nodes overlapping the old or new box; each leaf there
+// ends up listing pid exactly when it overlaps the new box. Enclosing index:
+// only the owners of the two boxes change. Lists stay sorted either way.
+void QuadtreeNode::PatchPartition(int pid, const Rect& oldBox, const Rect& newBox) {
+    if (partitionIndex == PartitionIndex::Enclosing) {
+        auto owner = [&](const Rect& box) -> QuadtreeNode* {
+            if (box.x1 > box.x2 || !BoxOverlapsRegion(box, region)) return nullptr;  // removed or outside
+            return const_cast<QuadtreeNode*>(EnclosingNode(box.x1, box.y1, box.x2, box.y2));
+        };
+        if (QuadtreeNode* from = owner(oldBox)) {
+            auto it = lower_bound(from->graphPartitionIDs.begin(), from->graphPartitionIDs.end(), pid);
+            if (it != from->graphPartitionIDs.end() && *it == pid) from->graphPartitionIDs.erase(it);
+            from->PackBoxes();
         }
-    } 
-     // If not a leaf, recursively check all children and collect their results
-    else {
-        
-        for (auto* ch : this->children) {
-         auto sub= ch-> RectQuery(topLeftX, topLeftY, bottomRightX,bottomRightY);
-             partitionsInRectangle.insert(sub.begin(), sub.end());
+        if (QuadtreeNode* to = owner(newBox)) {
+            auto it = lower_bound(to->graphPartitionIDs.begin(), to->graphPartitionIDs.end(), pid);
+            if (it == to->graphPartitionIDs.end() || *it != pid) to->graphPartitionIDs.insert(it, pid);
+            to->PackBoxes();  // Also when pid stays here with a new box
         }
+        return;
+    }
+    bool inNew = BoxOverlapsRegion(newBox, region);
+    if (!inNew && !BoxOverlapsRegion(oldBox, region)) return;
+    if (children.empty()) {
+        auto it = lower_bound(graphPartitionIDs.begin(), graphPartitionIDs.end(), pid);
+        bool listed = it != graphPartitionIDs.end() && *it == pid;
+        if (inNew && !listed) graphPartitionIDs.insert(it, pid);
+        else if (!inNew && listed) graphPartitionIDs.erase(it);
+        if (inNew || listed) PackBoxes();  // Also when pid stays listed with a new box
+        return;
     }
+    for (auto* ch : children) ch->PatchPartition(pid, oldBox, newBox);
+}
 
-    return vector<string>( partitionsInRectangle.begin(),  partitionsInRectangle.end());
+// Any partition sharing an edge with pid overlaps its box grown by one unit,
+// so a tree query finds the candidates and the exact touch tests decide
+PartitionNeighbours QuadtreeNode::FindTouching(int pid) const {
+    PartitionNeighbours touching;
+    const Partition& p = (*graphPtr)[pid];
+    vector<int> candidates;
+    RectQuery(p.x1 - 1, p.y1 - 1, p.x2 + 1, p.y2 + 1, candidates);
+    for (int other : candidates) {
+        if (other == pid) continue;
+        const Partition& q = (*graphPtr)[other];
+        if (isHorizontallyTouching(p, q)) touching.horizontal.push_back(other);
+        else if (isVerticallyTouching(p, q)) touching.vertical.push_back(other);
+    }
+    sort(touching.horizontal.begin(), touching.horizontal.end());
+    sort(touching.vertical.begin(), touching.vertical.end());
+    return touching;
 }
-               // ================ Line (Net) Intersection ===================
-// Returns partitions that intersect the line between two points
-vector<string> QuadtreeNode::NetIntersect(int x_start, int y_start, int x_end, int y_end) {
-    unordered_set<string>  partitionsOnLine;
- auto& graph = *graphPtr;
-      // Bounding box check to skip unnecessary nodes
-    if ((max(x_start, x_end) < this->region.x) || (min(x_start, x_end) > this->region.x + this->region.width) ||
-        (max(y_start, y_end) < this->region.y) || (min(y_start, y_end) > this->region.y + this->region.height)) {
-        return {};
-    }
-
-    if (this->children.empty()) {
-        for (int pid : this->graphPartitionIDs) {
-            const Partition& p = graph[pid];
-// Check if either  startvertex or endvertex of the line is inside the partition box
-            bool startInside = (x_start >= p.x1 && x_start <= p.x2 && y_start >= p.y1 && y_start <= p.y2);
-            bool endInside   = (x_end   >= p.x1 && x_end   <= p.x2 && y_end   >= p.y1 && y_end   <= p.y2);
-
-   // Check if line passes through partition's bounding box
-            bool boxOverlap = !(max(x_start, x_end) < p.x1 || min(x_start, x_end) > p.x2 ||
-                               max(y_start, y_end) < p.y1 || min(y_start, y_end) > p.y2);
-
-            if (startInside || endInside || boxOverlap) {
-                partitionsOnLine.insert(p.name);
+
+int QuadtreeNode::AddPartition(const Partition& p, PartitionNeighbours* touching) {
+    if (compactPtr || !graphPtr) return -1;
+    // Corners may come in any order, as in ResizePartition
+    Partition box = {p.name, min(p.x1, p.x2), min(p.y1, p.y2), max(p.x1, p.x2), max(p.y1, p.y2)};
+    int pid = (int)boost::add_vertex(box, *graphPtr);
+    PatchPartition(pid, removedBox, PartitionBox(pid));
+    NotifyChange(TreeChange::Partitions, PartitionBox(pid));
+    PartitionNeighbours found = FindTouching(pid);
+    for (int other : found.horizontal) boost::add_edge(pid, other, *graphPtr);
+    if (touching) *touching = std::move(found);
+    return pid;
+}
+
+bool QuadtreeNode::RemovePartition(int pid) {
+    if (compactPtr || !graphPtr || pid < 0 || pid >= (int)boost::num_vertices(*graphPtr)) return false;
+    Rect oldBox = PartitionBox(pid);
+    boost::clear_vertex(pid, *graphPtr);
+    (*graphPtr)[pid] = removedPartition;
+    PatchPartition(pid, oldBox, removedBox);
+    NotifyChange(TreeChange::Partitions, oldBox);
+    return true;
+}
+
+bool QuadtreeNode::ResizePartition(int pid, int x1, int y1, int x2, int y2, PartitionNeighbours* touching) {
+    if (compactPtr || !graphPtr || pid < 0 || pid >= (int)boost::num_vertices(*graphPtr)) return false;
+    Partition& p = (*graphPtr)[pid];
+    if (p.x1 > p.x2) return false;  // removed
+    Rect oldBox = PartitionBox(pid);
+    boost::clear_vertex(pid, *graphPtr);
+    p.x1 = min(x1, x2); p.y1 = min(y1, y2);
+    p.x2 = max(x1, x2); p.y2 = max(y1, y2);
+    PatchPartition(pid, oldBox, PartitionBox(pid));
+    NotifyChange(TreeChange::Partitions, oldBox);
+    NotifyChange(TreeChange::Partitions, PartitionBox(pid));
+    PartitionNeighbours found = FindTouching(pid);
+    for (int other : found.horizontal) boost::add_edge(pid, other, *graphPtr);
+    if (touching) *touching = std::move(found);
+    return true;
+}
+
+// ================ Path (Polyline) Query =====================
+
+// Returns true if the box lies inside this node's closed region
+bool QuadtreeNode::ContainsBox(int x1, int y1, int x2, int y2) const {
+    return x1 >= region.x && x2 <= region.x + region.width &&
+           y1 >= region.y && y2 <= region.y + region.height;
+}
+
+// Returns true if the box lies inside this node's open region (touching no border)
+bool QuadtreeNode::ContainsBoxInterior(int x1, int y1, int x2, int y2) const {
+    return x1 > region.x && x2 < region.x + region.width &&
+           y1 > region.y && y2 < region.y + region.height;
+}
+
+// Climbs from this node until the box fits (or the root is reached), then
+// descends while a single child still holds the whole box
+const QuadtreeNode* QuadtreeNode::EnclosingNode(int x1, int y1, int x2, int y2) const {
+    const QuadtreeNode* node = this;
+    while (node->parent && !node->ContainsBox(x1, y1, x2, y2)) node = node->parent;
+    bool descended = true;
+    while (descended) {
+        descended = false;
+        for (auto* ch : node->children) {
+            if (ch->ContainsBox(x1, y1, x2, y2)) {
+                node = ch;
+                descended = true;
+                break;
             }
         }
-    } else {
-        for (auto* ch : this->children) {
-            vector<string> sub = ch->NetIntersect(x_start, y_start, x_end, y_end);
-           partitionsOnLine.insert(sub.begin(), sub.end());
+    }
+    return node;
+}
+
+// Like EnclosingNode, but the box must lie strictly inside the node. A segment
+// on (or touching) a child border is then searched from the parent, so the
+// partitions on both sides of that border are found.
+const QuadtreeNode* QuadtreeNode::InteriorNode(int x1, int y1, int x2, int y2) const {
+    const QuadtreeNode* node = this;
+    while (node->parent && !node->ContainsBoxInterior(x1, y1, x2, y2)) node = node->parent;
+    bool descended = true;
+    while (descended) {
+        descended = false;
+        for (auto* ch : node->children) {
+            if (ch->ContainsBoxInterior(x1, y1, x2, y2)) {
+                node = ch;
+                descended = true;
+                break;
+            }
         }
     }
-    return vector<string>(partitionsOnLine.begin(), partitionsOnLine.end());}
+    return node;
+}
+
+void QuadtreeNode::PathQuery(const vector<pair<Point, Point>>& path, PathQueryResult& result) const {
+    result.partitions.clear();
+    result.edges.clear();
 
+    QueryScratch& scratch = defaultScratch;
+    vector<pair<double, int>> hits;  // (entry parameter along the segment, partition)
+    const QuadtreeNode* frontier = this;
 
+    for (const auto& seg : path) {
+        const Point& a = seg.first;
+        const Point& b = seg.second;
+        frontier = frontier->InteriorNode(min(a.x, b.x), min(a.y, b.y), max(a.x, b.x), max(a.y, b.y));
 
+        // Partitions crossed by this segment, ordered by where the segment enters them
+        hits.clear();
+        scratch.Begin(PartitionCount());
+        auto collect = [&](int pid) {
+            Rect p = PartitionBox(pid);
+            hits.emplace_back(SegmentBoxEntry(a.x, a.y, b.x, b.y, p.x1, p.y1, p.x2, p.y2), pid);
+        };
+        frontier->VisitNetNode(a.x, a.y, b.x, b.y, scratch, collect);
+        // Nodes above the frontier only store partitions with the enclosing index
+        for (const QuadtreeNode* up = frontier->parent; up; up = up->parent)
+            if (!up->graphPartitionIDs.empty())
+                for (int pid : up->NodeNetHits(a.x, a.y, b.x, b.y)) collect(pid);
+        sort(hits.begin(), hits.end());
+
+        for (const auto& hit : hits) {
+            int pid = hit.second;
+            if (!result.partitions.empty() && result.partitions.back() == pid) continue;
+            if (!result.partitions.empty()) {
+                int prev = result.partitions.back();
+                if (HasChannelEdge(prev, pid))
+                    result.edges.emplace_back(prev, pid);
+            }
+            result.partitions.push_back(pid);
+        }
+    }
+}
+
+// ================ Batch Queries =============================
+
+// Spreads the low 16 bits of v so a zero bit sits between each pair (Morton helper)
+static uint32_t SpreadBits(uint32_t v) {
+    v &= 0xFFFF;
+    v = (v | (v << 8)) & 0x00FF00FF;
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+// Orders queries along a Z-curve over the root region (by query centre), splits
+// the order into one contiguous, spatially coherent chunk per thread and runs
+// visit(chunk) on each. Every query belongs to exactly one chunk.
+static void RunBatch(const Vertex& root, const vector<pair<long long, long long>>& centers, int threads,
+                     const std::function<void(vector<int>&)>& visit) {
+    size_t n = centers.size();
+    if (n == 0) return;
+    if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+    if (threads <= 0) threads = 1;
+    threads = (int)std::min<size_t>(threads, n);
+
+    auto quantize = [](long long v, long long origin, long long extent) {
+        long long q = extent > 0 ? (v - origin) * 0xFFFF / extent : 0;
+        return (uint32_t)std::max(0LL, std::min(0xFFFFLL, q));
+    };
+    vector<pair<uint32_t, int>> order(n);
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t qx = quantize(centers[i].first, root.x, root.width);
+        uint32_t qy = quantize(centers[i].second, root.y, root.height);
+        order[i] = {SpreadBits(qx) | (SpreadBits(qy) << 1), (int)i};
+    }
+    sort(order.begin(), order.end());
+
+    vector<vector<int>> chunks(threads);
+    for (size_t i = 0; i < n; ++i)
+        chunks[i * threads / n].push_back(order[i].second);
+
+    vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(visit, std::ref(chunks[t]));
+    visit(chunks[0]);
+    for (auto& th : pool) th.join();
+}
+
+// Keeps the active queries that overlap this node, tests them against the
+// partitions stored here (each read once for all queries) and recurses.
+// levels[depth] holds this node's survivors; siblings reuse the same buffer.
+void QuadtreeNode::BatchRect(const vector<int>& active, const vector<Rect>& rects, vector<vector<int>>& results,
+                             deque<vector<int>>& levels, size_t depth) const {
+    if (depth == levels.size()) levels.emplace_back();
+    vector<int>& here = levels[depth];
+    here.clear();
+    for (int q : active) {
+        const Rect& r = rects[q];
+        if (!(region.x + region.width <= r.x1 || region.x >= r.x2 ||
+              region.y + region.height <= r.y1 || region.y >= r.y2))
+            here.push_back(q);
+    }
+    if (here.empty()) return;
+
+    for (size_t k = 0; k < graphPartitionIDs.size(); ++k) {
+        int pid = graphPartitionIDs[k];
+        Rect p = StoredBox(k);
+        for (int q : here) {
+            const Rect& r = rects[q];
+            if (max(r.x1, p.x1) < min(r.x2, p.x2) && max(r.y1, p.y1) < min(r.y2, p.y2))
+                results[q].push_back(pid);
+        }
+    }
+    for (auto* ch : children) ch->BatchRect(here, rects, results, levels, depth + 1);
+}
+
+vector<vector<int>> QuadtreeNode::RectQueryBatch(const vector<Rect>& rects, int threads) const {
+    // Normalise corners once so the traversal only compares
+    vector<Rect> norm(rects.size());
+    vector<pair<long long, long long>> centers(rects.size());
+    for (size_t i = 0; i < rects.size(); ++i) {
+        const Rect& r = rects[i];
+        norm[i] = {min(r.x1, r.x2), min(r.y1, r.y2), max(r.x1, r.x2), max(r.y1, r.y2)};
+        centers[i] = {((long long)norm[i].x1 + norm[i].x2) / 2, ((long long)norm[i].y1 + norm[i].y2) / 2};
+    }
+
+    vector<vector<int>> results(rects.size());
+    RunBatch(region, centers, threads, [&](vector<int>& chunk) {
+        deque<vector<int>> levels;
+        BatchRect(chunk, norm, results, levels, 0);
+        for (int q : chunk) {
+            sort(results[q].begin(), results[q].end());
+            results[q].erase(unique(results[q].begin(), results[q].end()), results[q].end());
+        }
+    });
+    return results;
+}
+
+// Same shape as BatchRect using NetIntersect's exact segment tests
+void QuadtreeNode::BatchNet(const vector<int>& active, const vector<Segment>& segs, vector<vector<int>>& results,
+                            deque<vector<int>>& levels, size_t depth) const {
+    if (depth == levels.size()) levels.emplace_back();
+    vector<int>& here = levels[depth];
+    here.clear();
+    for (int q : active) {
+        const Segment& s = segs[q];
+        if (SegmentIntersectsBox(s.start.x, s.start.y, s.end.x, s.end.y, region.x, region.y,
+                                 region.x + region.width, region.y + region.height))
+            here.push_back(q);
+    }
+    if (here.empty()) return;
+
+    for (size_t k = 0; k < graphPartitionIDs.size(); ++k) {
+        int pid = graphPartitionIDs[k];
+        Rect p = StoredBox(k);
+        for (int q : here) {
+            const Segment& s = segs[q];
+            if (SegmentIntersectsBox(s.start.x, s.start.y, s.end.x, s.end.y, p.x1, p.y1, p.x2, p.y2))
+                results[q].push_back(pid);
+        }
+    }
+    for (auto* ch : children) ch->BatchNet(here, segs, results, levels, depth + 1);
+}
+
+vector<vector<int>> QuadtreeNode::NetIntersectBatch(const vector<Segment>& segs, int threads) const {
+    vector<pair<long long, long long>> centers(segs.size());
+    for (size_t i = 0; i < segs.size(); ++i)
+        centers[i] = {((long long)segs[i].start.x + segs[i].end.x) / 2, ((long long)segs[i].start.y + segs[i].end.y) / 2};
+
+    vector<vector<int>> results(segs.size());
+    RunBatch(region, centers, threads, [&](vector<int>& chunk) {
+        deque<vector<int>> levels;
+        BatchNet(chunk, segs, results, levels, 0);
+        for (int q : chunk) {
+            sort(results[q].begin(), results[q].end());
+            results[q].erase(unique(results[q].begin(), results[q].end()), results[q].end());
+        }
+    });
+    return results;
+}
@@ -1,11 +1,15 @@
 #ifndef QUADTREE_H
 #define QUADTREE_H
 #include <vector>
+#include <deque>
 #include <string>
 #include <iostream>
 #include <algorithm>
 #include <unordered_set>
+#include <functional>
 #include "ChannelGraph.h"
+#include "CompactChannelGraph.h"
+#include "Geometry.h"
 using namespace std;
 
 // Represents a rectangular region in 2D space along with its level in the quadtree
@@ -17,44 +21,296 @@ struct Vertex {
 struct Point{
     int x ,y;
 };
+// Query rectangle (corners in any order) for batch queries
+struct Rect {
+    int x1, y1, x2, y2;
+};
+// Net segment between two points for batch queries
+struct Segment {
+    Point start, end;
+};
+// Result of PathQuery: what a multi-segment net crosses, in path order
+struct PathQueryResult {
+    vector<int> partitions;         // Partitions crossed, consecutive repeats collapsed
+    vector<pair<int, int>> edges;   // ChannelGraph edges used between consecutive partitions
+};
+
+// Outcome of a point operation (InsertPoint, SearchPoint, DeletePoint)
+enum class PointStatus {
+    Ok,
+    OutsideBoundary,  // The point lies outside the root region
+    NoLeaf,           // No child covers the point; the deepest node reached is reported
+    NotFound          // DeletePoint only: the leaf does not hold the point
+};
+
+// What a point operation did, so callers decide what (if anything) to print
+struct PointResult {
+    PointStatus status = PointStatus::OutsideBoundary;
+    int leafID = -1;             // Leaf holding the point (deepest node reached for NoLeaf)
+    Rect region = {0, 0, 0, 0};  // That node's region as closed corners
+    vector<int> path;            // Node IDs from the root down to leafID
+    vector<int> partitions;      // SearchPoint only: leaf partitions containing the point
+};
+
+// Where a built tree keeps each partition's ID
+enum class PartitionIndex {
+    Leaves,    // In every leaf the partition overlaps (default)
+    Enclosing  // Once, at the smallest node holding the whole partition (MX-CIF)
+};
+
+// Partitions sharing an edge with an edited partition
+struct PartitionNeighbours {
+    vector<int> horizontal;  // Side by side (these are the ChannelGraph edges)
+    vector<int> vertical;    // Stacked
+};
+
+// What a tree edit changed, as reported to an attached QueryCache. The region is
+// closed: a node's region after a point split/merge, or a partition's old/new box.
+enum class TreeChange {
+    Leaves,      // Leaves inside region split or merged (point insert/delete)
+    Partitions,  // A partition with this box was added, removed or moved
+    Rebuilt      // The tree was (re)built; region is the root's
+};
+
+class QueryCache;
+
+// Query instrumentation is compiled in only with QUADTREE_STATS; otherwise every
+// counter update below expands to nothing
+#ifdef QUADTREE_STATS
+#define QUADTREE_STAT(statement) statement
+#else
+#define QUADTREE_STAT(statement) ((void)0)
+#endif
+
+// Work done by one RectQuery / NetIntersect (filled only with QUADTREE_STATS)
+struct QueryStats {
+    size_t nodesVisited = 0;    // Nodes whose region was tested
+    size_t leavesTested = 0;    // Leaves whose partitions were tested
+    size_t partitionTests = 0;  // Partition boxes tested (at every node with the enclosing index)
+    size_t duplicates = 0;      // Hits suppressed because another leaf reported them
+    int maxDepth = 0;           // Deepest node level entered
+};
+
+// Shape of a built tree, gathered by a walk on demand (always available)
+struct TreeStats {
+    size_t nodes = 0, leaves = 0, points = 0;
+    vector<size_t> nodesPerLevel;       // Index = node level
+    // Leaves bucketed by count: bucket 0 holds 0, bucket b holds [2^(b-1), 2^b)
+    vector<size_t> pointsHistogram;     // Stored points per leaf (occupancy)
+    vector<size_t> partitionsHistogram; // Partition IDs per leaf
+    size_t maxPartitionsPerLeaf = 0;
+    size_t partitionRefs = 0;           // Partition IDs stored over all nodes
+};
+
+// Reusable dedup state for ID-based queries. Each query bumps the epoch and a
+// partition is reported only while its stamp differs, so no per-query clearing
+// or hashing is needed once the stamp array has grown to the graph size.
+struct QueryScratch {
+    vector<unsigned> stamp;
+    unsigned epoch = 0;
+    QueryStats stats; // Counters for the query last run with this scratch
+    vector<int> hits; // Box indices matched at one node by the Geometry.h batch kernels
+
+    // Starts a new query over a graph with partitionCount vertices
+    void Begin(size_t partitionCount) {
+        QUADTREE_STAT(stats = QueryStats());
+        if (stamp.size() < partitionCount) stamp.resize(partitionCount, 0);
+        if (++epoch == 0) {  // wrapped: old stamps could collide, reset them
+            fill(stamp.begin(), stamp.end(), 0);
+            epoch = 1;
+        }
+    }
+    // Returns true the first time pid is seen in the current query
+    bool Mark(int pid) {
+        if (stamp[pid] == epoch) return false;
+        stamp[pid] = epoch;
+        return true;
+    }
+};
+
 class QuadtreeNode {
 private:
      Vertex region; // Current region this node represents
     vector<QuadtreeNode*> children; // Child nodes (4 children in case of subdivision)
     vector<pair<int, int>> points; // Points stored in this node (only in leaves)
-    vector<int> graphPartitionIDs; // Partition IDs from the ChannelGraph overlapping this node
+    vector<int> graphPartitionIDs; // Partition IDs stored at this node (see PartitionIndex), sorted
+    vector<int> packedBoxes; // Their boxes in the same order as SoA columns: x1[n], y1[n], x2[n], y2[n]
     QuadtreeNode* parent; // Pointer to the parent node
     int id; // Unique ID for the node
     static int currentID; // Static counter for assigning unique IDs
     ChannelGraph* graphPtr; // Pointer to the associated channel graph
+    const CompactChannelGraph* compactPtr; // Frozen CSR graph, used instead of graphPtr when set
     vector<QuadtreeNode*> leafNodes; // Stores all leaf nodes for querying etc.
+    int leafIndex; // Position of this leaf in the root's leafNodes (-1 if not listed)
+    int pointCapacity; // Points a leaf holds before splitting (0 = never split)
+    bool splitForPoints; // Created by a point split, so it may be merged back
+    PartitionIndex partitionIndex; // Where this tree stores partition IDs
     void GenerateDot(std::ostream& out) const; // Used for visualization (Graphviz DOT format)
+    static std::function<void(const string&)> logger; // Diagnostics sink (empty = silent)
+    QueryCache* queryCache; // Root only: cache told about edits (see QueryCache::Attach)
+    unsigned shapeVersion; // Root only: bumped whenever leaves split, merge or are rebuilt
+
+    QuadtreeNode(const Vertex& r, ChannelGraph* g, int nodeID); // Node with explicit ID (parallel build)
+
+    // Partition access through whichever graph backs this tree
+    Rect PartitionBox(int pid) const {
+        if (compactPtr) return {compactPtr->X1(pid), compactPtr->Y1(pid), compactPtr->X2(pid), compactPtr->Y2(pid)};
+        const Partition& p = (*graphPtr)[pid];
+        return {p.x1, p.y1, p.x2, p.y2};
+    }
+    string PartitionName(int pid) const { return compactPtr ? compactPtr->Name(pid) : (*graphPtr)[pid].name; }
+    size_t PartitionCount() const { return compactPtr ? compactPtr->NumPartitions() : boost::num_vertices(*graphPtr); }
+    bool HasChannelEdge(int a, int b) const {
+        return compactPtr ? compactPtr->HasEdge(a, b) : boost::edge(a, b, *graphPtr).second;
+    }
+    // Column c (0..3 = x1, y1, x2, y2) of the packed boxes
+    const int* BoxColumn(int c) const { return packedBoxes.data() + c * graphPartitionIDs.size(); }
+    Rect StoredBox(size_t k) const {
+        size_t n = graphPartitionIDs.size();
+        return {packedBoxes[k], packedBoxes[n + k], packedBoxes[2 * n + k], packedBoxes[3 * n + k]};
+    }
+    void PackBoxes(); // Refreshes packedBoxes after graphPartitionIDs or one of their boxes changed
+    bool IsLeafSized(int minW, int minH) const; // True when the region needs no further split
+    void FilterPartitions(const vector<int>& parentIDs, vector<int>& out) const; // Parent's partitions overlapping this node
+    vector<int> RootPartitions() const; // All graph partitions overlapping this node
+    bool IsUniform(const vector<int>& ids) const; // Empty, or fully inside one partition
+    bool StopsAt(int minW, int minH, bool stopWhenUniform, const vector<int>& ids) const; // Leaf test during builds
+    bool Owns(const Rect& p) const; // Enclosing index: this is the smallest node holding p
+    void StorePartitions(vector<int>& ids); // Keeps the overlapping ids this node stores
+    void SubdivideWith(int minW, int minH, int scale, bool stopWhenUniform, vector<int>& ids); // Recursive serial build
+    void CreateChildren(int scale, bool assignIds); // Adds scale x scale child nodes
+    void BuildSubtree(int minW, int minH, int scale, bool stopWhenUniform, vector<int>& ids); // Thread-safe build (no IDs/leaf list)
+    void NumberChildren(); // Assigns IDs in serial Subdivide order
+    void CollectLeaves(vector<QuadtreeNode*>& out); // Leaves below this node, depth-first
+    void AccumulateStats(TreeStats& stats) const; // GetTreeStats walk step
+    void PatchPartition(int pid, const Rect& oldBox, const Rect& newBox); // Fix leaf lists after an edit
+    PartitionNeighbours FindTouching(int pid) const; // Touching partitions, found through the tree
+    QuadtreeNode* Root(); // Walks up to the root
+    void NotifyChange(TreeChange change, const Rect& region); // Tells the root's cache, if any
+    Rect ClosedRegion() const { return {region.x, region.y, region.x + region.width, region.y + region.height}; }
+    void AddLeaf(QuadtreeNode* leaf); // Appends to this root's leafNodes
+    void RemoveLeaf(QuadtreeNode* leaf); // O(1) swap-and-pop removal from this root's leafNodes
+    void SplitForPoints(); // Turns an over-full leaf into 2x2 children
+    void MergeAfterDelete(); // Folds under-full point-split children back into this node
+    const QuadtreeNode* Descend(int x, int y, PointResult& result) const; // Silent root-to-leaf walk
+    size_t DistributePoints(pair<int, int>* data, pair<int, int>* tmp, size_t n); // Bulk-load step for one subtree
+    template <class Visitor>
+    void VisitRectNode(int x1, int y1, int x2, int y2, QueryScratch& scratch, Visitor& visit) const;
+    bool ContainsBox(int x1, int y1, int x2, int y2) const; // Closed region fully holds the box
+    const QuadtreeNode* EnclosingNode(int x1, int y1, int x2, int y2) const; // Smallest node near this one holding the box
+    bool ContainsBoxInterior(int x1, int y1, int x2, int y2) const; // Open region holds the box (no border contact)
+    const QuadtreeNode* InteriorNode(int x1, int y1, int x2, int y2) const; // Smallest node near this one holding the box in its interior
+    const vector<int>& NodeNetHits(int xs, int ys, int xe, int ye) const; // Stored partitions the segment crosses
+    template <class Visitor>
+    void VisitNetNode(int xs, int ys, int xe, int ye, QueryScratch& scratch, Visitor& visit) const;
+    // Shared-traversal batches; levels holds one reused query buffer per depth below the batch root
+    void BatchRect(const vector<int>& active, const vector<Rect>& rects, vector<vector<int>>& results,
+                   deque<vector<int>>& levels, size_t depth) const;
+    void BatchNet(const vector<int>& active, const vector<Segment>& segs, vector<vector<int>>& results,
+                  deque<vector<int>>& levels, size_t depth) const;
 
 
 public:
    // Constructor: Initializes the node with its region and associated ChannelGraph
     QuadtreeNode(const Vertex& r, ChannelGraph* g);
 
+    // Constructor: Initializes the node over a frozen CSR channel graph
+    QuadtreeNode(const Vertex& r, const CompactChannelGraph* g);
+
     // Destructor: Frees all child nodes
     ~QuadtreeNode();
 
     // Returns a string in DOT format representing the tree rooted at this node
     string GetDotRepresentation() const;
 
-    // Subdivides the current node into 4 children recursively if region size > minW and minH
-    void Subdivide(int minW, int minH, int scale);
+    // Subdivides the current node into 4 children recursively if region size > minW and minH.
+    // With stopWhenUniform, nodes that are empty or inside a single partition stay leaves.
+    void Subdivide(int minW, int minH, int scale, bool stopWhenUniform = false);
 
-    // Inserts a point (x, y) into the appropriate leaf node
-    void InsertPoint(int x, int y);
+    // Same result as Subdivide (IDs, leaf order) but subtrees are built on worker threads.
+    // threads <= 0 uses the hardware concurrency.
+    void SubdivideParallel(int minW, int minH, int scale, int threads = 0, bool stopWhenUniform = false);
 
-    // Searches for the point and stores path of node IDs from root to that point
-    void SearchPoint(int x, int y, vector<int>& path);
+    // Chooses where Subdivide (any variant) stores partition IDs; set it on the root
+    // before building. With Enclosing each partition is stored once, at the
+    // smallest node holding it, and queries test the partitions of every node
+    // they pass, so results need no deduplication.
+    void SetPartitionIndex(PartitionIndex index) { partitionIndex = index; }
+    PartitionIndex GetPartitionIndex() const { return partitionIndex; }
 
-    // Deletes a point (x, y) if present in a leaf node
-    void DeletePoint(int x, int y);
+    // Cache to invalidate when this tree changes; QueryCache::Attach sets it on the root
+    void SetQueryCache(QueryCache* cache) { queryCache = cache; }
 
-    // Finds the path from a leaf node (containing x, y) up to the root
-    void PathToRoot(int x, int y, vector<int>& path);
+    // Changes whenever the leaf layout under this root does (rebuilds, point
+    // splits and merges); indexes holding leaf pointers compare it before use
+    unsigned ShapeVersion() const { return shapeVersion; }
+
+    // Routes diagnostics (failed point operations, splits, merges) to sink; pass an
+    // empty function to silence them. Building with QUADTREE_NO_LOGGING removes them.
+    static void SetLogger(std::function<void(const string&)> sink);
+
+    // Inserts a point (x, y) into the appropriate leaf node. Reports the leaf it
+    // ends up in, after any capacity split.
+    PointResult InsertPoint(int x, int y);
+
+    // Inserts many points at once without per-point output. Call on the root.
+    // Points are radix-partitioned down the tree in parallel and appended to
+    // each leaf in one go; over-full leaves are split afterwards.
+    // Returns the number of points that landed in a leaf.
+    size_t BulkInsertPoints(const vector<Point>& pts, int threads = 0);
+
+    // Finds the leaf holding the point, the path to it and the partitions containing it
+    PointResult SearchPoint(int x, int y) const;
+
+    // Same descent as SearchPoint without output: returns the first partition of the
+    // leaf that contains (x, y), or -1 if there is none
+    int LocatePartition(int x, int y) const;
+
+    // Deletes one stored point (x, y); the leaf stays, but point-split siblings
+    // that fall to half the capacity are merged back into their parent.
+    // The reported leaf is the one the point was removed from.
+    PointResult DeletePoint(int x, int y);
+
+    // Leaves holding more than capacity points split into 2x2 children (0 = never).
+    // Applies to this node and everything below it.
+    void SetPointCapacity(int capacity);
+
+    // The k stored points closest to (x, y), nearest first
+    vector<pair<int, int>> NearestPoints(int x, int y, int k) const;
+
+    // All stored points within distance radius of (x, y)
+    vector<pair<int, int>> PointsInRadius(int x, int y, int radius) const;
+
+    // Number of points stored below this node
+    size_t PointCount() const;
+
+    // Incremental floorplan edits; call on the root of a ChannelGraph-backed tree
+    // (a tree over a frozen CSR graph returns -1/false, and CSR copies of the
+    // graph must be rebuilt afterwards). Touching partitions are found through
+    // the tree, only the edited vertex's edges change, and only leaves overlapping
+    // the old or new box are patched. Removed partitions keep their ID as an
+    // empty tombstone so other IDs stay valid. touching receives the neighbours.
+    int AddPartition(const Partition& p, PartitionNeighbours* touching = nullptr);
+    bool RemovePartition(int pid);
+    bool ResizePartition(int pid, int x1, int y1, int x2, int y2, PartitionNeighbours* touching = nullptr);
+
+    // Node counts per level and per-leaf occupancy/partition histograms below this node
+    TreeStats GetTreeStats() const;
+
+    // Counters of the last query this thread ran through the overloads without a
+    // scratch argument (use QueryScratch::stats otherwise). All zero unless the
+    // tree is compiled with QUADTREE_STATS, which StatsEnabled() reports.
+    static const QueryStats& LastQueryStats();
+    static constexpr bool StatsEnabled() {
+#ifdef QUADTREE_STATS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Appends the node IDs from the root down to the leaf containing (x, y)
+    PointStatus PathToRoot(int x, int y, vector<int>& path) const;
 
     // Returns list of partition names that intersect the rectangle defined by (x1,y1)-(x2,y2)
     vector<string> RectQuery(int x1, int y1, int x2, int y2);
@@ -62,6 +318,36 @@ public:
     // Returns list of partition names that a line segment (x1,y1)-(x2,y2) intersects
     vector<string> NetIntersect(int x1, int y1, int x2, int y2);
 
+    // Calls visit(pid) once for every partition overlapping the rectangle (corners in any order)
+    template <class Visitor>
+    void VisitRect(int x1, int y1, int x2, int y2, QueryScratch& scratch, Visitor&& visit) const;
+
+    // Calls visit(pid) once for every partition the segment (x1,y1)-(x2,y2) intersects
+    // (exact segment/box test). visit must not start another net query on the same thread.
+    template <class Visitor>
+    void VisitNet(int x1, int y1, int x2, int y2, QueryScratch& scratch, Visitor&& visit) const;
+
+    // ID forms of RectQuery/NetIntersect: out is cleared and refilled with ChannelGraph
+    // vertex indices, so a reused buffer and scratch make querying allocation-free.
+    // The overloads without scratch use a per-thread one.
+    void RectQuery(int x1, int y1, int x2, int y2, vector<int>& out, QueryScratch& scratch) const;
+    void RectQuery(int x1, int y1, int x2, int y2, vector<int>& out) const;
+    void NetIntersect(int x1, int y1, int x2, int y2, vector<int>& out, QueryScratch& scratch) const;
+    void NetIntersect(int x1, int y1, int x2, int y2, vector<int>& out) const;
+
+    // Walks a multi-segment net in order. Each segment starts its search from the
+    // smallest node near the previous one that holds it clear of its borders
+    // (moving up or down as needed), so consecutive segments reuse the same part
+    // of the tree and segments on a node border still see both sides.
+    void PathQuery(const vector<pair<Point, Point>>& path, PathQueryResult& result) const;
+
+    // Answers many rectangles in one shared traversal; results[i] holds the sorted
+    // partition IDs (ChannelGraph vertex indices) for rects[i]. threads <= 0 uses all cores.
+    vector<vector<int>> RectQueryBatch(const vector<Rect>& rects, int threads = 0) const;
+
+    // Batch form of NetIntersect with the same result layout as RectQueryBatch
+    vector<vector<int>> NetIntersectBatch(const vector<Segment>& segs, int threads = 0) const;
+
     // Returns a reference to the current list of leaf nodes (modifiable)
     vector<QuadtreeNode*>& GetLeafNodes();
 
@@ -69,7 +355,7 @@ public:
     const vector<QuadtreeNode*>& GetLeafNodes() const;
 
     // Checks if a point (x,y) lies within this node's boundary
-    bool InBoundary(int x, int y);
+    bool InBoundary(int x, int y) const;
 
     // Returns the region (rectangle) that this node represents
     const Vertex& getRegion() const {
@@ -77,6 +363,73 @@ public:
     }
  const vector<QuadtreeNode*>& GetChildren() const { return children; }
 
+    // Unique ID of this node and the partition IDs stored at it (all overlapping
+    // ones at a leaf, or the ones it encloses with PartitionIndex::Enclosing).
+    // Their boxes are copied next to them when they are stored, so partitions
+    // must change through Add/Remove/ResizePartition or a rebuild.
+    int GetID() const { return id; }
+    const vector<int>& GetPartitionIDs() const { return graphPartitionIDs; }
+
+    // Box of partition pid as closed corners, from whichever graph backs the tree
+    Rect GetPartitionBox(int pid) const { return PartitionBox(pid); }
+
 };
 
+// ================ Visitor queries ===========================
+
+template <class Visitor>
+void QuadtreeNode::VisitRectNode(int x1, int y1, int x2, int y2, QueryScratch& scratch, Visitor& visit) const {
+    QUADTREE_STAT(++scratch.stats.nodesVisited; scratch.stats.maxDepth = max(scratch.stats.maxDepth, region.level));
+    // No intersection with this node
+    if (region.x + region.width <= x1 || region.x >= x2 ||
+        region.y + region.height <= y1 || region.y >= y2)
+        return;
+    // Internal nodes only store partitions with the enclosing index, which
+    // stores each one once, so only leaf-indexed hits need the dedup stamp
+    bool unique = partitionIndex == PartitionIndex::Enclosing;
+    QUADTREE_STAT(scratch.stats.leavesTested += children.empty(); scratch.stats.partitionTests += graphPartitionIDs.size());
+    int n = (int)graphPartitionIDs.size();
+    if (n) {
+        if ((int)scratch.hits.size() < n) scratch.hits.resize(n);
+        int count = RectOverlapsBoxes(x1, y1, x2, y2, BoxColumn(0), BoxColumn(1), BoxColumn(2), BoxColumn(3),
+                                      n, scratch.hits.data());
+        for (int k = 0; k < count; ++k) {
+            int pid = graphPartitionIDs[scratch.hits[k]];
+            if (unique || scratch.Mark(pid)) visit(pid);
+            else QUADTREE_STAT(++scratch.stats.duplicates);
+        }
+    }
+    for (auto* ch : children) ch->VisitRectNode(x1, y1, x2, y2, scratch, visit);
+}
+
+template <class Visitor>
+void QuadtreeNode::VisitRect(int x1, int y1, int x2, int y2, QueryScratch& scratch, Visitor&& visit) const {
+    scratch.Begin(PartitionCount());
+    VisitRectNode(min(x1, x2), min(y1, y2), max(x1, x2), max(y1, y2), scratch, visit);
+}
+
+template <class Visitor>
+void QuadtreeNode::VisitNetNode(int xs, int ys, int xe, int ye, QueryScratch& scratch, Visitor& visit) const {
+    QUADTREE_STAT(++scratch.stats.nodesVisited; scratch.stats.maxDepth = max(scratch.stats.maxDepth, region.level));
+    // Skip nodes the segment itself misses, not just its bounding box
+    if (!SegmentIntersectsBox(xs, ys, xe, ye, region.x, region.y,
+                              region.x + region.width, region.y + region.height))
+        return;
+    QUADTREE_STAT(scratch.stats.leavesTested += children.empty(); scratch.stats.partitionTests += graphPartitionIDs.size());
+    if (!graphPartitionIDs.empty()) {
+        bool unique = partitionIndex == PartitionIndex::Enclosing;
+        for (int pid : NodeNetHits(xs, ys, xe, ye)) {
+            if (unique || scratch.Mark(pid)) visit(pid);
+            else QUADTREE_STAT(++scratch.stats.duplicates);
+        }
+    }
+    for (auto* ch : children) ch->VisitNetNode(xs, ys, xe, ye, scratch, visit);
+}
+
+template <class Visitor>
+void QuadtreeNode::VisitNet(int x1, int y1, int x2, int y2, QueryScratch& scratch, Visitor&& visit) const {
+    scratch.Begin(PartitionCount());
+    VisitNetNode(x1, y1, x2, y2, scratch, visit);
+}
+
 #endif
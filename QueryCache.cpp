@@ -0,0 +1,204 @@
+#include "QueryCache.h"
+#include "Geometry.h"
+
+// ================= Setup ====================================
+
+QueryCache::QueryCache(size_t capacity, int grid)
+    : tree(nullptr), capacity(capacity), grid(max(grid, 1)), pointEntries(0) {}
+
+QueryCache::~QueryCache() {
+    Attach(nullptr);
+}
+
+void QueryCache::Attach(QuadtreeNode* t) {
+    if (tree && tree != t) tree->SetQueryCache(nullptr);
+    tree = t;
+    if (tree) tree->SetQueryCache(this);
+    Clear();
+}
+
+void QueryCache::Configure(size_t newCapacity, int newGrid) {
+    capacity = newCapacity;
+    grid = max(newGrid, 1);
+    Clear();
+}
+
+void QueryCache::Clear() {
+    entries.clear();
+    index.clear();
+    pointEntries = 0;
+}
+
+// ================= LRU bookkeeping ==========================
+
+// Floor / ceiling to a multiple of grid (also for negative coordinates)
+int QueryCache::SnapDown(int v) const {
+    int r = v % grid;
+    return r < 0 ? v - r - grid : v - r;
+}
+
+int QueryCache::SnapUp(int v) const {
+    int down = SnapDown(v);
+    return down == v ? v : down + grid;
+}
+
+QueryCache::Entry* QueryCache::Find(const Key& key) {
+    auto it = index.find(key);
+    if (it == index.end()) {
+        ++stats.misses;
+        return nullptr;
+    }
+    ++stats.hits;
+    entries.splice(entries.begin(), entries, it->second);
+    return &*it->second;
+}
+
+QueryCache::Entry& QueryCache::Insert(const Key& key) {
+    while (entries.size() >= capacity) {
+        pointEntries -= entries.back().key.kind == Kind::Point;
+        index.erase(entries.back().key);
+        entries.pop_back();
+        ++stats.evictions;
+    }
+    entries.push_front(Entry());
+    entries.front().key = key;
+    index[key] = entries.begin();
+    pointEntries += key.kind == Kind::Point;
+    return entries.front();
+}
+
+// ================= Queries ==================================
+
+// The tree only reports what it finds inside its root, so the exact filters
+// test the part of each partition inside the root region
+Rect QueryCache::ClipToRoot(const Rect& box) const {
+    const Vertex& r = tree->getRegion();
+    return {max(box.x1, r.x), max(box.y1, r.y), min(box.x2, r.x + r.width), min(box.y2, r.y + r.height)};
+}
+
+// The entry holds the partitions overlapping the snapped box, a superset of
+// the query's; the tree's own overlap test picks the query's out of it
+void QueryCache::RectQuery(int x1, int y1, int x2, int y2, vector<int>& out) {
+    if (!tree) {
+        out.clear();
+        return;
+    }
+    if (capacity == 0) {
+        tree->RectQuery(x1, y1, x2, y2, out, scratch);
+        return;
+    }
+    int qx1 = min(x1, x2), qy1 = min(y1, y2), qx2 = max(x1, x2), qy2 = max(y1, y2);
+    Key key = {Kind::Rect, SnapDown(qx1), SnapDown(qy1), SnapUp(qx2), SnapUp(qy2)};
+    Entry* e = Find(key);
+    if (!e) {
+        e = &Insert(key);
+        tree->RectQuery(key.x1, key.y1, key.x2, key.y2, e->ids, scratch);
+    }
+    if (key.x1 == qx1 && key.y1 == qy1 && key.x2 == qx2 && key.y2 == qy2) {
+        out = e->ids;
+        return;
+    }
+    out.clear();
+    for (int pid : e->ids) {
+        Rect p = ClipToRoot(tree->GetPartitionBox(pid));
+        if (max(qx1, p.x1) < min(qx2, p.x2) && max(qy1, p.y1) < min(qy2, p.y2)) out.push_back(pid);
+    }
+}
+
+// With a grid, segments share an entry per snapped bounding box. A partition
+// the segment touches, even only at its border, strictly overlaps that box
+// grown by one unit, so a rect query over it gives the superset to filter.
+void QueryCache::NetIntersect(int x1, int y1, int x2, int y2, vector<int>& out) {
+    if (!tree) {
+        out.clear();
+        return;
+    }
+    if (capacity == 0) {
+        tree->NetIntersect(x1, y1, x2, y2, out, scratch);
+        return;
+    }
+    if (grid == 1) {
+        Key key = {Kind::Net, x1, y1, x2, y2};
+        Entry* e = Find(key);
+        if (!e) {
+            e = &Insert(key);
+            tree->NetIntersect(x1, y1, x2, y2, e->ids, scratch);
+        }
+        out = e->ids;
+        return;
+    }
+    Key key = {Kind::NetBox, SnapDown(min(x1, x2)), SnapDown(min(y1, y2)), SnapUp(max(x1, x2)), SnapUp(max(y1, y2))};
+    Entry* e = Find(key);
+    if (!e) {
+        e = &Insert(key);
+        tree->RectQuery(key.x1 - 1, key.y1 - 1, key.x2 + 1, key.y2 + 1, e->ids, scratch);
+    }
+    out.clear();
+    for (int pid : e->ids) {
+        Rect box = tree->GetPartitionBox(pid), p = ClipToRoot(box);
+        if (SegmentIntersectsBox(x1, y1, x2, y2, p.x1, p.y1, p.x2, p.y2)) {
+            out.push_back(pid);
+        } else if (SegmentIntersectsBox(x1, y1, x2, y2, box.x1, box.y1, box.x2, box.y2)) {
+            // Hit only outside the root: whether the tree reports it depends on
+            // which of its nodes the segment crosses, so ask the tree
+            tree->NetIntersect(x1, y1, x2, y2, out, scratch);
+            return;
+        }
+    }
+}
+
+// Leaf, path and partitions all depend on the exact point, so points are never snapped
+PointResult QueryCache::SearchPoint(int x, int y) {
+    if (!tree) return PointResult();
+    if (capacity == 0) return tree->SearchPoint(x, y);
+    Key key = {Kind::Point, x, y, x, y};
+    Entry* e = Find(key);
+    if (!e) {
+        e = &Insert(key);
+        e->point = tree->SearchPoint(x, y);
+    }
+    return e->point;
+}
+
+// ================= Invalidation =============================
+
+static bool ClosedOverlap(const Rect& a, int x1, int y1, int x2, int y2) {
+    return a.x1 <= x2 && a.x2 >= x1 && a.y1 <= y2 && a.y2 >= y1;
+}
+
+// Whether the edit can change e's answer. Closed tests, so borders count as affected.
+bool QueryCache::Affected(const Entry& e, TreeChange change, const Rect& r) const {
+    const Key& k = e.key;
+    if (change == TreeChange::Leaves) {
+        // Only SearchPoint reports leaves; a split/merge elsewhere leaves its path alone
+        return k.kind == Kind::Point && ClosedOverlap(r, k.x1, k.y1, k.x1, k.y1);
+    }
+    if (r.x1 > r.x2) return false;  // removed (inverted) box
+    switch (k.kind) {
+    case Kind::Rect:  return ClosedOverlap(r, k.x1, k.y1, k.x2, k.y2);
+    case Kind::NetBox: return ClosedOverlap(r, k.x1 - 1, k.y1 - 1, k.x2 + 1, k.y2 + 1);
+    case Kind::Net:   return SegmentIntersectsBox(k.x1, k.y1, k.x2, k.y2, r.x1, r.y1, r.x2, r.y2);
+    case Kind::Point: return ClosedOverlap(r, k.x1, k.y1, k.x1, k.y1);
+    }
+    return true;
+}
+
+void QueryCache::Invalidate(TreeChange change, const Rect& region) {
+    if (entries.empty()) return;
+    if (change == TreeChange::Rebuilt) {
+        stats.invalidated += entries.size();
+        Clear();
+        return;
+    }
+    if (change == TreeChange::Leaves && pointEntries == 0) return;
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (Affected(*it, change, region)) {
+            pointEntries -= it->key.kind == Kind::Point;
+            index.erase(it->key);
+            it = entries.erase(it);
+            ++stats.invalidated;
+        } else {
+            ++it;
+        }
+    }
+}
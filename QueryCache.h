@@ -0,0 +1,109 @@
+#ifndef QUERY_CACHE_H
+#define QUERY_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include "Quadtree.h"
+
+using namespace std;
+
+// Counters since the cache was created or ResetStats was called
+struct QueryCacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;    // Least recently used entries dropped to stay within capacity
+    size_t invalidated = 0;  // Entries dropped because the tree changed under them
+};
+
+// Bounded LRU cache in front of one QuadtreeNode's RectQuery, NetIntersect and
+// SearchPoint, for workloads that repeat (or nearly repeat) the same windows.
+//
+// With grid 1 every query is its own key. With a larger grid, rectangles are
+// snapped outward to grid lines and segments to their snapped bounding box;
+// the entry holds the partitions of that larger area and each hit filters them
+// exactly, so queries in the same cells share one entry. The filters test the
+// part of each partition inside the root, which is all the tree searches; a
+// segment hitting a partition only outside the root goes to the tree. Results
+// hold the same IDs as the tree's; with a grid, RectQuery/NetIntersect order may differ.
+//
+// The attached tree reports its edits (TreeChange) and only entries whose
+// answer the edit can change are dropped: point splits/merges drop SearchPoint
+// entries inside the changed region, partition edits drop entries whose area
+// touches the old or new box, and rebuilds drop everything.
+// Not thread-safe: hits reorder the LRU list.
+class QueryCache {
+public:
+    // capacity 0 keeps nothing (every query goes to the tree)
+    explicit QueryCache(size_t capacity = 4096, int grid = 1);
+    ~QueryCache();
+    QueryCache(const QueryCache&) = delete;
+    QueryCache& operator=(const QueryCache&) = delete;
+
+    // Serves queries from tree (a root) from now on and empties the cache.
+    // nullptr detaches; a destroyed tree detaches itself.
+    void Attach(QuadtreeNode* tree);
+    QuadtreeNode* Tree() const { return tree; }
+
+    // New limits; empties the cache
+    void Configure(size_t capacity, int grid);
+    size_t Capacity() const { return capacity; }
+    int Grid() const { return grid; }
+    size_t Size() const { return entries.size(); }
+
+    // Cached forms of the tree queries (same arguments and results)
+    void RectQuery(int x1, int y1, int x2, int y2, vector<int>& out);
+    void NetIntersect(int x1, int y1, int x2, int y2, vector<int>& out);
+    PointResult SearchPoint(int x, int y);
+
+    // Drops the entries change can affect; called by the attached tree
+    void Invalidate(TreeChange change, const Rect& region);
+    void Clear();
+
+    const QueryCacheStats& Stats() const { return stats; }
+    void ResetStats() { stats = QueryCacheStats(); }
+
+private:
+    enum class Kind : uint8_t { Rect, Net, NetBox, Point };
+
+    // Rect/NetBox: normalized (snapped) box; Net: segment as given; Point: x, y
+    struct Key {
+        Kind kind;
+        int x1, y1, x2, y2;
+        bool operator==(const Key& o) const {
+            return kind == o.kind && x1 == o.x1 && y1 == o.y1 && x2 == o.x2 && y2 == o.y2;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const {
+            uint64_t h = (uint64_t)k.kind;
+            for (int v : {k.x1, k.y1, k.x2, k.y2}) h = (h ^ (uint32_t)v) * 0x100000001b3ULL;
+            return (size_t)(h ^ (h >> 29));
+        }
+    };
+    struct Entry {
+        Key key;
+        vector<int> ids;     // Rect / Net / NetBox
+        PointResult point;   // Point
+    };
+    typedef list<Entry>::iterator EntryRef;
+
+    QuadtreeNode* tree;
+    size_t capacity;
+    int grid;
+    list<Entry> entries;  // Most recently used first
+    unordered_map<Key, EntryRef, KeyHash> index;
+    size_t pointEntries;  // Entries of Kind::Point (only these see leaf changes)
+    QueryScratch scratch;
+    QueryCacheStats stats;
+
+    int SnapDown(int v) const;
+    int SnapUp(int v) const;
+    Rect ClipToRoot(const Rect& box) const;
+    Entry* Find(const Key& key);      // Moves a hit to the front
+    Entry& Insert(const Key& key);    // New front entry, evicting from the back
+    bool Affected(const Entry& e, TreeChange change, const Rect& region) const;
+};
+
+#endif
@@ -0,0 +1,298 @@
+#include "Snapshot.h"
+#include <cstring>
+#include <fstream>
+#include <queue>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char SNAPSHOT_MAGIC[8] = {'Q', 'T', 'S', 'N', 'A', 'P', 0, 0};
+static const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+// Rounds a section offset up to 8 bytes
+static uint64_t Align8(uint64_t v) { return (v + 7) & ~uint64_t(7); }
+
+// ================= Writer ===================================
+
+bool WriteSnapshot(const QuadtreeNode& tree, const ChannelGraph& graph, const string& path) {
+    // Breadth-first layout: a node's children are appended together when it is visited
+    vector<SnapshotNode> nodes;
+    vector<int32_t> pool;
+    vector<const QuadtreeNode*> order{&tree};
+    for (size_t i = 0; i < order.size(); ++i) {
+        const QuadtreeNode* node = order[i];
+        const Vertex& r = node->getRegion();
+        SnapshotNode sn{r.x, r.y, r.width, r.height, r.level, node->GetID(), -1, 0, 0, 0};
+        sn.partBegin = (int32_t)pool.size();
+        pool.insert(pool.end(), node->GetPartitionIDs().begin(), node->GetPartitionIDs().end());
+        sn.partEnd = (int32_t)pool.size();
+        if (!node->GetChildren().empty()) {
+            sn.firstChild = (int32_t)order.size();
+            sn.childCount = (int32_t)node->GetChildren().size();
+            order.insert(order.end(), node->GetChildren().begin(), node->GetChildren().end());
+        }
+        nodes.push_back(sn);
+    }
+
+    vector<SnapshotPartition> parts;
+    string names;
+    for (auto v : boost::make_iterator_range(vertices(graph))) {
+        const Partition& p = graph[v];
+        parts.push_back({p.x1, p.y1, p.x2, p.y2, (uint32_t)names.size(), (uint32_t)p.name.size()});
+        names += p.name;
+    }
+    vector<int32_t> edgeList;
+    for (auto e : boost::make_iterator_range(boost::edges(graph))) {
+        edgeList.push_back((int32_t)boost::source(e, graph));
+        edgeList.push_back((int32_t)boost::target(e, graph));
+    }
+
+    SnapshotHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+    h.version = SNAPSHOT_VERSION;
+    h.byteOrder = SNAPSHOT_BYTE_ORDER;
+    h.nodeCount = nodes.size();
+    h.poolCount = pool.size();
+    h.partitionCount = parts.size();
+    h.nameBytes = names.size();
+    h.edgeCount = edgeList.size() / 2;
+    h.nodeOffset = Align8(sizeof(h));
+    h.poolOffset = Align8(h.nodeOffset + nodes.size() * sizeof(SnapshotNode));
+    h.partitionOffset = Align8(h.poolOffset + pool.size() * sizeof(int32_t));
+    h.nameOffset = Align8(h.partitionOffset + parts.size() * sizeof(SnapshotPartition));
+    h.edgeOffset = Align8(h.nameOffset + names.size());
+    h.fileSize = h.edgeOffset + edgeList.size() * sizeof(int32_t);
+
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out) return false;
+    auto writeAt = [&](uint64_t offset, const void* data, size_t bytes) {
+        static const char zeros[8] = {0};
+        uint64_t pos = (uint64_t)out.tellp();
+        if (offset > pos) out.write(zeros, offset - pos);  // alignment padding
+        if (bytes) out.write((const char*)data, bytes);
+    };
+    writeAt(0, &h, sizeof(h));
+    writeAt(h.nodeOffset, nodes.data(), nodes.size() * sizeof(SnapshotNode));
+    writeAt(h.poolOffset, pool.data(), pool.size() * sizeof(int32_t));
+    writeAt(h.partitionOffset, parts.data(), parts.size() * sizeof(SnapshotPartition));
+    writeAt(h.nameOffset, names.data(), names.size());
+    writeAt(h.edgeOffset, edgeList.data(), edgeList.size() * sizeof(int32_t));
+    return (bool)out;
+}
+
+// ================= Mapping ==================================
+
+MappedSnapshot::MappedSnapshot()
+    : base(nullptr), size(0),
+#ifdef _WIN32
+      fileHandle(nullptr), mapHandle(nullptr),
+#endif
+      header(nullptr), nodes(nullptr), pool(nullptr), partitions(nullptr), names(nullptr), edges(nullptr) {}
+
+MappedSnapshot::~MappedSnapshot() {
+    Close();
+}
+
+void MappedSnapshot::Close() {
+    if (base) {
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+        CloseHandle((HANDLE)mapHandle);
+        CloseHandle((HANDLE)fileHandle);
+        mapHandle = fileHandle = nullptr;
+#else
+        munmap(base, size);
+#endif
+    }
+    base = nullptr;
+    size = 0;
+    header = nullptr;
+    nodes = nullptr;
+    pool = nullptr;
+    partitions = nullptr;
+    names = nullptr;
+    edges = nullptr;
+}
+
+bool MappedSnapshot::Open(const string& path, string& error) {
+    Close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) { error = "cannot open file"; return false; }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    HANDLE mapping = fileSize.QuadPart ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        error = "cannot map file";
+        return false;
+    }
+    fileHandle = file;
+    mapHandle = mapping;
+    base = view;
+    size = (size_t)fileSize.QuadPart;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) { error = "cannot open file"; return false; }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        error = "cannot stat file";
+        return false;
+    }
+    void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // the mapping stays valid
+    if (view == MAP_FAILED) { error = "cannot map file"; return false; }
+    base = view;
+    size = (size_t)st.st_size;
+#endif
+
+    // Header checks before trusting any offsets
+    const char* bytes = (const char*)base;
+    auto fail = [&](const char* why) { error = why; Close(); return false; };
+    if (size < sizeof(SnapshotHeader)) return fail("file too small");
+    header = (const SnapshotHeader*)bytes;
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) return fail("not a quadtree snapshot");
+    if (header->version != SNAPSHOT_VERSION) return fail("unsupported snapshot version");
+    if (header->byteOrder != SNAPSHOT_BYTE_ORDER) return fail("snapshot written with a different byte order");
+    if (header->fileSize != size) return fail("truncated snapshot");
+
+    auto section = [&](uint64_t offset, uint64_t count, size_t elem) {
+        return offset % 8 == 0 && offset <= size && count <= (size - offset) / elem;
+    };
+    if (!section(header->nodeOffset, header->nodeCount, sizeof(SnapshotNode)) || header->nodeCount == 0 ||
+        !section(header->poolOffset, header->poolCount, sizeof(int32_t)) ||
+        !section(header->partitionOffset, header->partitionCount, sizeof(SnapshotPartition)) ||
+        !section(header->nameOffset, header->nameBytes, 1) ||
+        !section(header->edgeOffset, header->edgeCount * 2, sizeof(int32_t)))
+        return fail("section out of range");
+
+    nodes = (const SnapshotNode*)(bytes + header->nodeOffset);
+    pool = (const int32_t*)(bytes + header->poolOffset);
+    partitions = (const SnapshotPartition*)(bytes + header->partitionOffset);
+    names = bytes + header->nameOffset;
+    edges = (const int32_t*)(bytes + header->edgeOffset);
+
+    // Index checks so queries never leave the mapping
+    int64_t nodeCount = (int64_t)header->nodeCount, poolCount = (int64_t)header->poolCount;
+    for (int64_t i = 0; i < nodeCount; ++i) {
+        const SnapshotNode& n = nodes[i];
+        if (n.childCount < 0 || (n.childCount > 0 && (n.firstChild <= i || n.firstChild + (int64_t)n.childCount > nodeCount)))
+            return fail("bad child range");
+        if (n.partBegin < 0 || n.partBegin > n.partEnd || n.partEnd > poolCount)
+            return fail("bad partition range");
+    }
+    for (int64_t k = 0; k < poolCount; ++k)
+        if (pool[k] < 0 || (uint64_t)pool[k] >= header->partitionCount) return fail("bad partition ID");
+    for (uint64_t p = 0; p < header->partitionCount; ++p)
+        if ((uint64_t)partitions[p].nameOffset + partitions[p].nameLength > header->nameBytes)
+            return fail("bad partition name");
+    return true;
+}
+
+string MappedSnapshot::PartitionName(int pid) const {
+    return string(names + partitions[pid].nameOffset, partitions[pid].nameLength);
+}
+
+// ================= Queries ==================================
+
+bool MappedSnapshot::InNode(const SnapshotNode& n, int x, int y) const {
+    return x >= n.x && x <= n.x + n.width && y >= n.y && y <= n.y + n.height;
+}
+
+PointResult MappedSnapshot::SearchPoint(int x, int y) const {
+    PointResult result;
+    if (!InNode(nodes[0], x, y)) return result;  // OutsideBoundary
+    int n = 0;
+    bool reachedLeaf = true;
+    vector<int> visited;  // Node indices on the path; enclosing-index trees store partitions above the leaf
+    while (true) {
+        visited.push_back(n);
+        result.path.push_back(nodes[n].id);
+        if (nodes[n].childCount == 0) break;
+        int next = -1;
+        for (int c = nodes[n].firstChild; c < nodes[n].firstChild + nodes[n].childCount; ++c) {
+            if (InNode(nodes[c], x, y)) { next = c; break; }
+        }
+        if (next < 0) { reachedLeaf = false; break; }
+        n = next;
+    }
+    const SnapshotNode& node = nodes[n];
+    result.leafID = node.id;
+    result.region = {node.x, node.y, node.x + node.width, node.y + node.height};
+    result.status = reachedLeaf ? PointStatus::Ok : PointStatus::NoLeaf;
+    if (!reachedLeaf) return result;
+
+    for (int v : visited) {
+        for (int k = nodes[v].partBegin; k < nodes[v].partEnd; ++k) {
+            const SnapshotPartition& p = partitions[pool[k]];
+            if (x >= p.x1 && x <= p.x2 && y >= p.y1 && y <= p.y2) result.partitions.push_back(pool[k]);
+        }
+    }
+    sort(result.partitions.begin(), result.partitions.end());
+    return result;
+}
+
+void MappedSnapshot::CollectRect(int n, int x1, int y1, int x2, int y2, vector<int>& out) {
+    const SnapshotNode& node = nodes[n];
+    if (node.x + node.width <= x1 || node.x >= x2 || node.y + node.height <= y1 || node.y >= y2)
+        return;
+    for (int k = node.partBegin; k < node.partEnd; ++k) {
+        const SnapshotPartition& p = partitions[pool[k]];
+        if (max(x1, p.x1) < min(x2, p.x2) && max(y1, p.y1) < min(y2, p.y2) && scratch.Mark(pool[k]))
+            out.push_back(pool[k]);
+    }
+    for (int c = node.firstChild; c >= 0 && c < node.firstChild + node.childCount; ++c)
+        CollectRect(c, x1, y1, x2, y2, out);
+}
+
+void MappedSnapshot::RectQuery(int x1, int y1, int x2, int y2, vector<int>& out) {
+    out.clear();
+    scratch.Begin(header->partitionCount);
+    CollectRect(0, min(x1, x2), min(y1, y2), max(x1, x2), max(y1, y2), out);
+}
+
+void MappedSnapshot::CollectLine(int n, int xs, int ys, int xe, int ye, vector<int>& out) {
+    const SnapshotNode& node = nodes[n];
+    if (!SegmentIntersectsBox(xs, ys, xe, ye, node.x, node.y, node.x + node.width, node.y + node.height))
+        return;
+    for (int k = node.partBegin; k < node.partEnd; ++k) {
+        const SnapshotPartition& p = partitions[pool[k]];
+        if (SegmentIntersectsBox(xs, ys, xe, ye, p.x1, p.y1, p.x2, p.y2) && scratch.Mark(pool[k]))
+            out.push_back(pool[k]);
+    }
+    for (int c = node.firstChild; c >= 0 && c < node.firstChild + node.childCount; ++c)
+        CollectLine(c, xs, ys, xe, ye, out);
+}
+
+void MappedSnapshot::NetIntersect(int x1, int y1, int x2, int y2, vector<int>& out) {
+    out.clear();
+    scratch.Begin(header->partitionCount);
+    CollectLine(0, x1, y1, x2, y2, out);
+}
+
+vector<string> MappedSnapshot::RectQuery(int x1, int y1, int x2, int y2) {
+    vector<int> ids;
+    RectQuery(x1, y1, x2, y2, ids);
+    vector<string> result;
+    for (int pid : ids) result.push_back(PartitionName(pid));
+    return result;
+}
+
+vector<string> MappedSnapshot::NetIntersect(int x1, int y1, int x2, int y2) {
+    vector<int> ids;
+    NetIntersect(x1, y1, x2, y2, ids);
+    vector<string> result;
+    for (int pid : ids) result.push_back(PartitionName(pid));
+    return result;
+}
@@ -0,0 +1,93 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Quadtree.h"
+#include "ChannelGraph.h"
+
+using namespace std;
+
+// ---- On-disk layout (version 1, native byte order) ----
+// Header, then 8-byte aligned sections at the offsets recorded in the header.
+// Nodes are laid out breadth-first so every node's children are contiguous.
+
+struct SnapshotHeader {
+    char magic[8];            // "QTSNAP\0\0"
+    uint32_t version;         // SNAPSHOT_VERSION
+    uint32_t byteOrder;       // 0x01020304 as written by the producer
+    uint64_t nodeCount, poolCount, partitionCount, nameBytes, edgeCount;
+    uint64_t nodeOffset, poolOffset, partitionOffset, nameOffset, edgeOffset;
+    uint64_t fileSize;
+};
+
+struct SnapshotNode {
+    int32_t x, y, width, height, level, id;
+    int32_t firstChild, childCount;   // Children are nodes[firstChild .. firstChild + childCount)
+    int32_t partBegin, partEnd;       // Partition IDs are pool[partBegin .. partEnd)
+};
+
+struct SnapshotPartition {
+    int32_t x1, y1, x2, y2;
+    uint32_t nameOffset, nameLength;  // Into the name section
+};
+
+const uint32_t SNAPSHOT_VERSION = 1;
+
+// Writes the built tree, its leaf partition lists and the graph's partitions and
+// edges to path. Returns false if the file cannot be written.
+bool WriteSnapshot(const QuadtreeNode& tree, const ChannelGraph& graph, const string& path);
+
+// Read-only view of a snapshot file mapped into memory. Queries run directly on
+// the mapped sections; nothing is copied into heap nodes.
+class MappedSnapshot {
+private:
+    void* base;          // Start of the mapping
+    size_t size;         // Length of the mapping
+#ifdef _WIN32
+    void* fileHandle;
+    void* mapHandle;
+#endif
+    const SnapshotHeader* header;
+    const SnapshotNode* nodes;
+    const int32_t* pool;
+    const SnapshotPartition* partitions;
+    const char* names;
+    const int32_t* edges;   // edgeCount (a, b) pairs
+    QueryScratch scratch;   // Dedup for ID queries
+
+    bool InNode(const SnapshotNode& n, int x, int y) const;
+    void CollectRect(int n, int x1, int y1, int x2, int y2, vector<int>& out);
+    void CollectLine(int n, int xs, int ys, int xe, int ye, vector<int>& out);
+
+public:
+    MappedSnapshot();
+    ~MappedSnapshot();
+    MappedSnapshot(const MappedSnapshot&) = delete;
+    MappedSnapshot& operator=(const MappedSnapshot&) = delete;
+
+    // Maps the file and validates its header; on failure error explains why
+    bool Open(const string& path, string& error);
+    void Close();
+    bool IsOpen() const { return base != nullptr; }
+
+    size_t NodeCount() const { return header ? header->nodeCount : 0; }
+    size_t PartitionCount() const { return header ? header->partitionCount : 0; }
+    size_t EdgeCount() const { return header ? header->edgeCount : 0; }
+    string PartitionName(int pid) const;
+
+    // Same result as QuadtreeNode::SearchPoint on the tree the snapshot was written
+    // from (partitions sorted by ID); nothing is printed
+    PointResult SearchPoint(int x, int y) const;
+
+    // Partition IDs overlapping the rectangle / crossed by the segment (out is refilled)
+    void RectQuery(int x1, int y1, int x2, int y2, vector<int>& out);
+    void NetIntersect(int x1, int y1, int x2, int y2, vector<int>& out);
+
+    // Name forms matching QuadtreeNode
+    vector<string> RectQuery(int x1, int y1, int x2, int y2);
+    vector<string> NetIntersect(int x1, int y1, int x2, int y2);
+};
+
+#endif
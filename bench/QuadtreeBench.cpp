@@ -0,0 +1,462 @@
+// Benchmark suite for the build and query paths. No dependencies beyond the
+// project sources; every workload is generated from a fixed seed so runs are
+// comparable across commits.
+//
+//   g++ -std=c++17 -O2 -pthread -I. bench/QuadtreeBench.cpp Quadtree.cpp ChannelGraph.cpp CompactChannelGraph.cpp Loader.cpp QueryCache.cpp ChannelCongestion.cpp -o qtbench
+//   ./qtbench [--filter text] [--ops n] [--reps n] [--seed n]
+//
+// Latencies are per operation (per build for Subdivide/makeChannelGraph, per file
+// for the Load benchmarks, which write scratch files to the working directory); Peak MB
+// is the process high-water mark after each benchmark.
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <queue>
+#include <cstdio>
+#include <cstring>
+#include "Quadtree.h"
+#include "ChannelGraph.h"
+#include "Loader.h"
+#include "QueryCache.h"
+#include "BasicQuadtree.h"
+#include "ChannelCongestion.h"
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+typedef chrono::steady_clock Clock;
+
+// ===================== Settings =====================
+
+struct BenchOptions {
+    string filter;        // Only run benchmarks whose name contains this
+    size_t ops = 100000;  // Operations per query benchmark
+    int reps = 5;         // Repetitions per build benchmark
+    unsigned seed = 42;
+};
+
+// ===================== Peak memory =====================
+
+// Peak resident set size of the process so far, in bytes
+static size_t PeakMemoryBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return pmc.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return (size_t)usage.ru_maxrss;         // bytes on macOS
+#else
+    return (size_t)usage.ru_maxrss * 1024;  // kilobytes on Linux
+#endif
+#endif
+}
+
+// ===================== Synthetic partitions =====================
+
+// Tiles size x size by recursive guillotine cuts at random positions, then drops
+// a share of the tiles so the channel graph has holes like real floorplans
+static vector<Partition> GuillotinePartitions(int size, int count, double keep, unsigned seed) {
+    mt19937 rng(seed);
+    vector<Partition> tiles{{"", 0, 0, size, size}};
+    auto area = [](const Partition& t) { return (long long)(t.x2 - t.x1) * (t.y2 - t.y1); };
+    // Largest area first, lowest index among equal areas
+    priority_queue<pair<long long, int>> bySize;
+    bySize.push({area(tiles[0]), 0});
+    while ((int)tiles.size() < count) {
+        // Split the largest tile across its longer side
+        int largest = -bySize.top().second;
+        bySize.pop();
+        Partition t = tiles[largest];
+        int w = t.x2 - t.x1, h = t.y2 - t.y1;
+        if (w < 2 && h < 2) break;
+        Partition a = t, b = t;
+        if (w >= h) {
+            int cut = t.x1 + 1 + (int)(rng() % (w - 1));
+            a.x2 = cut;
+            b.x1 = cut;
+        } else {
+            int cut = t.y1 + 1 + (int)(rng() % (h - 1));
+            a.y2 = cut;
+            b.y1 = cut;
+        }
+        tiles[largest] = a;
+        tiles.push_back(b);
+        bySize.push({area(a), -largest});
+        bySize.push({area(b), -(int)(tiles.size() - 1)});
+    }
+
+    vector<Partition> kept;
+    bernoulli_distribution keepTile(keep);
+    for (auto& t : tiles) {
+        if (!keepTile(rng)) continue;
+        t.name = "P" + to_string(kept.size() + 1);
+        kept.push_back(t);
+    }
+    return kept;
+}
+
+// Uniform cells x cells grid of equal partitions
+static vector<Partition> GridPartitions(int size, int cells) {
+    vector<Partition> grid;
+    int step = max(1, size / cells);
+    for (int x = 0; x < size; x += step)
+        for (int y = 0; y < size; y += step)
+            grid.push_back({"P" + to_string(grid.size() + 1), x, y, min(size, x + step), min(size, y + step)});
+    return grid;
+}
+
+// ===================== Workloads =====================
+
+// Uniform points over the square, or points drawn around a few hot spots
+static vector<Point> RandomPoints(int size, size_t n, bool clustered, unsigned seed) {
+    mt19937 rng(seed);
+    vector<Point> pts;
+    pts.reserve(n);
+    if (!clustered) {
+        uniform_int_distribution<int> coord(0, size);
+        for (size_t i = 0; i < n; ++i) pts.push_back({coord(rng), coord(rng)});
+        return pts;
+    }
+    uniform_int_distribution<int> coord(0, size);
+    vector<Point> centers;
+    for (int c = 0; c < 8; ++c) centers.push_back({coord(rng), coord(rng)});
+    normal_distribution<double> spread(0.0, size / 40.0);
+    for (size_t i = 0; i < n; ++i) {
+        const Point& c = centers[rng() % centers.size()];
+        int x = (int)(c.x + spread(rng)), y = (int)(c.y + spread(rng));
+        pts.push_back({max(0, min(size, x)), max(0, min(size, y))});
+    }
+    return pts;
+}
+
+// Query rectangles (or segments) with one corner from pts and sides up to maxSide
+static vector<Rect> RandomRects(const vector<Point>& pts, int maxSide, unsigned seed) {
+    mt19937 rng(seed);
+    uniform_int_distribution<int> side(1, maxSide);
+    vector<Rect> rects;
+    rects.reserve(pts.size());
+    for (const auto& p : pts) rects.push_back({p.x, p.y, p.x + side(rng), p.y + side(rng)});
+    return rects;
+}
+
+// ===================== Reporting =====================
+
+// Per-operation latencies in nanoseconds plus the wall time of the whole run
+struct Samples {
+    vector<double> latency;
+    double totalSeconds = 0;
+    size_t items = 0;  // Operations performed (for throughput)
+};
+
+static void PrintHeader() {
+    cout << left << setw(40) << "Benchmark" << right << setw(10) << "Items" << setw(14) << "Items/s"
+         << setw(12) << "p50 ns" << setw(12) << "p90 ns" << setw(12) << "p99 ns" << setw(12) << "Peak MB" << "\n"
+         << string(112, '-') << "\n";
+}
+
+static void Report(const string& name, Samples& s) {
+    sort(s.latency.begin(), s.latency.end());
+    auto pct = [&](double q) {
+        if (s.latency.empty()) return 0.0;
+        return s.latency[min(s.latency.size() - 1, (size_t)(q * s.latency.size()))];
+    };
+    double rate = s.totalSeconds > 0 ? s.items / s.totalSeconds : 0;
+    cout << left << setw(40) << name << right << setw(10) << s.items << setw(14) << fixed << setprecision(0) << rate
+         << setw(12) << pct(0.50) << setw(12) << pct(0.90) << setw(12) << pct(0.99)
+         << setw(12) << setprecision(1) << PeakMemoryBytes() / (1024.0 * 1024.0) << "\n";
+}
+
+// Times op(i) for i in [0, n) individually and as a whole
+static Samples TimeEach(size_t n, const function<void(size_t)>& op) {
+    Samples s;
+    s.latency.reserve(n);
+    auto begin = Clock::now();
+    for (size_t i = 0; i < n; ++i) {
+        auto t0 = Clock::now();
+        op(i);
+        s.latency.push_back(chrono::duration<double, nano>(Clock::now() - t0).count());
+    }
+    s.totalSeconds = chrono::duration<double>(Clock::now() - begin).count();
+    s.items = n;
+    return s;
+}
+
+// ===================== Benchmarks =====================
+
+struct Benchmark {
+    string name;
+    function<void(const BenchOptions&)> run;
+};
+
+// Partition counts scale with the region so leaves see a similar density
+static int PartitionsFor(int size) {
+    return size <= 100 ? 16 : size <= 1000 ? 400 : 4000;
+}
+
+static void AddGraphBenchmarks(vector<Benchmark>& all) {
+    for (int count : {100, 1000, 10000}) {
+        all.push_back({"makeChannelGraph/guillotine/" + to_string(count), [count](const BenchOptions& o) {
+            vector<Partition> parts = GuillotinePartitions(100000, count, 0.9, o.seed);
+            Samples s = TimeEach(o.reps, [&](size_t) {
+                ChannelGraph g;
+                makeChannelGraph(g, parts);
+            });
+            s.items = (size_t)o.reps * parts.size();
+            Report("makeChannelGraph/guillotine/" + to_string(count), s);
+        }});
+    }
+}
+
+static void AddSubdivideBenchmarks(vector<Benchmark>& all) {
+    for (int size : {100, 1000, 10000}) {
+        for (int scale : {2, 3, 4}) {
+            string name = "Subdivide/" + to_string(size) + "/scale:" + to_string(scale);
+            all.push_back({name, [=](const BenchOptions& o) {
+                ChannelGraph g;
+                makeChannelGraph(g, GuillotinePartitions(size, PartitionsFor(size), 0.9, o.seed));
+                size_t leaves = 0;
+                Samples s = TimeEach(o.reps, [&](size_t) {
+                    QuadtreeNode tree(Vertex(0, 0, size, size, 0), &g);
+                    tree.Subdivide(25, 25, scale);
+                    leaves = tree.GetLeafNodes().size();
+                });
+                s.items = (size_t)o.reps * leaves;  // throughput in leaves built per second
+                Report(name, s);
+            }});
+        }
+    }
+}
+
+// Query benchmarks share one 10000 x 10000 tree per workload shape
+static void AddQueryBenchmarks(vector<Benchmark>& all) {
+    const int size = 10000;
+    for (bool clustered : {false, true}) {
+        string shape = clustered ? "clustered" : "random";
+
+        all.push_back({"SearchPoint/" + shape, [=](const BenchOptions& o) {
+            ChannelGraph g;
+            makeChannelGraph(g, GuillotinePartitions(size, PartitionsFor(size), 0.9, o.seed));
+            QuadtreeNode tree(Vertex(0, 0, size, size, 0), &g);
+            tree.Subdivide(25, 25, 2);
+            vector<Point> pts = RandomPoints(size, o.ops, clustered, o.seed + 1);
+            size_t found = 0;
+            Samples s = TimeEach(pts.size(), [&](size_t i) {
+                found += tree.SearchPoint(pts[i].x, pts[i].y).partitions.size();
+            });
+            Report("SearchPoint/" + shape, s);
+        }});
+
+        all.push_back({"RectQuery/" + shape, [=](const BenchOptions& o) {
+            ChannelGraph g;
+            makeChannelGraph(g, GuillotinePartitions(size, PartitionsFor(size), 0.9, o.seed));
+            QuadtreeNode tree(Vertex(0, 0, size, size, 0), &g);
+            tree.Subdivide(25, 25, 2);
+            vector<Rect> rects = RandomRects(RandomPoints(size, o.ops, clustered, o.seed + 2), 500, o.seed + 3);
+            vector<int> out;
+            QueryScratch scratch;
+            Samples s = TimeEach(rects.size(), [&](size_t i) {
+                tree.RectQuery(rects[i].x1, rects[i].y1, rects[i].x2, rects[i].y2, out, scratch);
+            });
+            Report("RectQuery/" + shape, s);
+        }});
+
+        all.push_back({"NetIntersect/" + shape, [=](const BenchOptions& o) {
+            ChannelGraph g;
+            makeChannelGraph(g, GuillotinePartitions(size, PartitionsFor(size), 0.9, o.seed));
+            QuadtreeNode tree(Vertex(0, 0, size, size, 0), &g);
+            tree.Subdivide(25, 25, 2);
+            vector<Rect> nets = RandomRects(RandomPoints(size, o.ops, clustered, o.seed + 4), 2000, o.seed + 5);
+            vector<int> out;
+            QueryScratch scratch;
+            Samples s = TimeEach(nets.size(), [&](size_t i) {
+                tree.NetIntersect(nets[i].x1, nets[i].y1, nets[i].x2, nets[i].y2, out, scratch);
+            });
+            Report("NetIntersect/" + shape, s);
+        }});
+
+        all.push_back({"InsertPoint/" + shape, [=](const BenchOptions& o) {
+            ChannelGraph g;
+            makeChannelGraph(g, GuillotinePartitions(size, PartitionsFor(size), 0.9, o.seed));
+            QuadtreeNode tree(Vertex(0, 0, size, size, 0), &g);
+            tree.Subdivide(25, 25, 2);
+            tree.SetPointCapacity(64);
+            vector<Point> pts = RandomPoints(size, o.ops, clustered, o.seed + 6);
+            Samples s = TimeEach(pts.size(), [&](size_t i) { tree.InsertPoint(pts[i].x, pts[i].y); });
+            Report("InsertPoint/" + shape, s);
+        }});
+    }
+
+    // Uniform grid of equal partitions instead of guillotine tiles
+    all.push_back({"SearchPoint/grid", [=](const BenchOptions& o) {
+        ChannelGraph g;
+        makeChannelGraph(g, GridPartitions(size, 64));
+        QuadtreeNode tree(Vertex(0, 0, size, size, 0), &g);
+        tree.Subdivide(25, 25, 2);
+        vector<Point> pts = RandomPoints(size, o.ops, false, o.seed + 7);
+        Samples s = TimeEach(pts.size(), [&](size_t i) { tree.SearchPoint(pts[i].x, pts[i].y); });
+        Report("SearchPoint/grid", s);
+    }});
+
+    // Same guillotine floorplan and points as SearchPoint/random in the
+    // compile-time fan-out tree (arithmetic child selection)
+    all.push_back({"SearchPoint/basic2", [=](const BenchOptions& o) {
+        vector<BasicBox<int>> boxes;
+        for (const Partition& p : GuillotinePartitions(size, PartitionsFor(size), 0.9, o.seed))
+            boxes.push_back({p.x1, p.y1, p.x2, p.y2});
+        BasicQuadtree<int, 2> tree(0, 0, size, size);
+        tree.Build(boxes, 25, 25);
+        vector<Point> pts = RandomPoints(size, o.ops, false, o.seed + 1);
+        vector<int> out;
+        Samples s = TimeEach(pts.size(), [&](size_t i) { tree.SearchPoint(pts[i].x, pts[i].y, out); });
+        Report("SearchPoint/basic2", s);
+    }});
+}
+
+// RectQuery through a QueryCache on a repeating workload: windows are drawn from
+// a pool of 2000, exact copies (grid 1) or jittered by a few units (grid 64)
+static void AddCacheBenchmarks(vector<Benchmark>& all) {
+    const int size = 10000;
+    for (int grid : {1, 64}) {
+        string name = "CachedRectQuery/grid" + to_string(grid);
+        all.push_back({name, [=](const BenchOptions& o) {
+            ChannelGraph g;
+            makeChannelGraph(g, GuillotinePartitions(size, PartitionsFor(size), 0.9, o.seed));
+            QuadtreeNode tree(Vertex(0, 0, size, size, 0), &g);
+            tree.Subdivide(25, 25, 2);
+            vector<Rect> pool = RandomRects(RandomPoints(size, 2000, true, o.seed + 2), 500, o.seed + 3);
+            mt19937 rng(o.seed + 8);
+            vector<Rect> rects(o.ops);
+            for (auto& r : rects) {
+                r = pool[rng() % pool.size()];
+                if (grid > 1) {
+                    int dx = (int)(rng() % 9) - 4, dy = (int)(rng() % 9) - 4;
+                    r = {r.x1 + dx, r.y1 + dy, r.x2 + dx, r.y2 + dy};
+                }
+            }
+            QueryCache cache(4096, grid);
+            cache.Attach(&tree);
+            vector<int> out;
+            Samples s = TimeEach(rects.size(), [&](size_t i) {
+                cache.RectQuery(rects[i].x1, rects[i].y1, rects[i].x2, rects[i].y2, out);
+            });
+            Report(name, s);
+        }});
+    }
+}
+
+// Track usage: nets committed one by one, then window totals/peaks over the
+// committed usage (windows up to 2000 units, so whole subtrees are summarized)
+static void AddCongestionBenchmarks(vector<Benchmark>& all) {
+    const int size = 10000;
+    for (bool window : {false, true}) {
+        string name = window ? "CongestionWindow/random" : "CommitNet/random";
+        all.push_back({name, [=](const BenchOptions& o) {
+            ChannelGraph g;
+            vector<pair<size_t, size_t>> vertical;
+            makeChannelGraph(g, GuillotinePartitions(size, PartitionsFor(size), 0.9, o.seed), vertical);
+            CompactChannelGraph routing;
+            routing.Build(g, vertical);
+            QuadtreeNode tree(Vertex(0, 0, size, size, 0), &g);
+            tree.Subdivide(25, 25, 2);
+            ChannelCongestion congestion;
+            congestion.Attach(tree, routing, 4);
+            vector<Rect> nets = RandomRects(RandomPoints(size, o.ops, false, o.seed + 4), 2000, o.seed + 5);
+            if (window) {
+                for (const auto& n : nets) congestion.CommitNet(tree, n.x1, n.y1, n.x2, n.y2);
+                vector<Rect> rects = RandomRects(RandomPoints(size, o.ops, false, o.seed + 9), 2000, o.seed + 10);
+                long long usage = 0;
+                Samples s = TimeEach(rects.size(), [&](size_t i) {
+                    usage += congestion.Window(rects[i].x1, rects[i].y1, rects[i].x2, rects[i].y2).usage;
+                });
+                Report(name, s);
+            } else {
+                Samples s = TimeEach(nets.size(), [&](size_t i) {
+                    congestion.CommitNet(tree, nets[i].x1, nets[i].y1, nets[i].x2, nets[i].y2);
+                });
+                Report(name, s);
+            }
+        }});
+    }
+}
+
+// File ingestion: the same records written as text and binary, parsed back
+// through the mapped and buffered readers
+static void AddLoadBenchmarks(vector<Benchmark>& all) {
+    // 90k partitions, generated once per seed and shared by the four LoadPartitions rows
+    auto floorplan = [](unsigned seed) -> const vector<Partition>& {
+        static unsigned madeFor = 0;
+        static vector<Partition> parts;
+        if (parts.empty() || madeFor != seed) {
+            parts = GuillotinePartitions(100000, 100000, 0.9, seed);
+            madeFor = seed;
+        }
+        return parts;
+    };
+    for (bool binary : {false, true}) {
+        for (FileAccess access : {FileAccess::Mapped, FileAccess::Buffered}) {
+            string suffix = string(binary ? "binary" : "text") + (access == FileAccess::Mapped ? "/mapped" : "/buffered");
+            all.push_back({"LoadPartitions/" + suffix, [=](const BenchOptions& o) {
+                string file = string("qtbench_partitions.") + (binary ? "bin" : "txt");
+                SavePartitions(file, floorplan(o.seed), binary);
+                vector<Partition> parts;
+                string error;
+                Samples s = TimeEach(o.reps, [&](size_t) { LoadPartitions(file, parts, error, access); });
+                s.items = (size_t)o.reps * parts.size();
+                remove(file.c_str());
+                Report("LoadPartitions/" + suffix, s);
+            }});
+            all.push_back({"LoadPins/" + suffix, [=](const BenchOptions& o) {
+                string file = string("qtbench_pins.") + (binary ? "bin" : "txt");
+                SavePins(file, RandomPoints(100000, o.ops * 10, false, o.seed), binary);
+                vector<Point> pins;
+                string error;
+                Samples s = TimeEach(o.reps, [&](size_t) { LoadPins(file, pins, error, access); });
+                s.items = (size_t)o.reps * pins.size();
+                remove(file.c_str());
+                Report("LoadPins/" + suffix, s);
+            }});
+        }
+    }
+}
+
+// ===================== Main =====================
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--filter")) options.filter = argv[i + 1];
+        else if (!strcmp(argv[i], "--ops")) options.ops = strtoull(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--reps")) options.reps = max(1, atoi(argv[i + 1]));
+        else if (!strcmp(argv[i], "--seed")) options.seed = (unsigned)strtoul(argv[i + 1], nullptr, 10);
+        else {
+            cerr << "Unknown option " << argv[i] << "\n";
+            return 1;
+        }
+    }
+
+    vector<Benchmark> all;
+    AddGraphBenchmarks(all);
+    AddSubdivideBenchmarks(all);
+    AddQueryBenchmarks(all);
+    AddCacheBenchmarks(all);
+    AddCongestionBenchmarks(all);
+    AddLoadBenchmarks(all);
+
+    cout << "Seed " << options.seed << ", " << options.ops << " ops per query benchmark, "
+         << options.reps << " reps per build benchmark\n";
+    PrintHeader();
+    for (const auto& b : all)
+        if (options.filter.empty() || b.name.find(options.filter) != string::npos) b.run(options);
+    return 0;
+}
@@ -0,0 +1,128 @@
+// Randomized check that QueryCache answers RectQuery and NetIntersect with the
+// same IDs as its tree. Every round builds a random floorplan (partitions may
+// extend past the root), a tree in either partition index mode and a cache
+// with a random grid, then mixes queries with Add/Remove/ResizePartition edits.
+//
+//   g++ -std=c++17 -O2 -pthread -I. bench/QueryCacheFuzz.cpp Quadtree.cpp ChannelGraph.cpp CompactChannelGraph.cpp QueryCache.cpp -o qcfuzz
+//   ./qcfuzz [--rounds n] [--queries n] [--seed n]
+//
+// Prints the first mismatches and exits with 1 if any query disagreed.
+#include <iostream>
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include "Quadtree.h"
+#include "ChannelGraph.h"
+#include "QueryCache.h"
+
+using namespace std;
+
+struct FuzzOptions {
+    int rounds = 200;      // Trees built
+    int queries = 2000;    // Queries per tree (an edit every 100)
+    unsigned seed = 42;
+};
+
+struct FuzzCounts {
+    size_t checked = 0;
+    size_t rectFailures = 0;
+    size_t netFailures = 0;
+};
+
+// Compares one query's answers (order may differ with a grid)
+static void Compare(const char* query, int x1, int y1, int x2, int y2,
+                    vector<int>& fromTree, vector<int>& fromCache, FuzzCounts& counts) {
+    sort(fromTree.begin(), fromTree.end());
+    sort(fromCache.begin(), fromCache.end());
+    ++counts.checked;
+    if (fromTree == fromCache) return;
+    size_t& failures = query[0] == 'R' ? counts.rectFailures : counts.netFailures;
+    if (++failures <= 5)
+        cout << "[FAIL] " << query << " " << x1 << " " << y1 << " " << x2 << " " << y2
+             << ": tree " << fromTree.size() << " IDs, cache " << fromCache.size() << "\n";
+}
+
+// Box with corners drawn around the root, up to margin outside it
+static Partition RandomBox(mt19937& rng, const string& name, int w, int h, int margin) {
+    int x1 = (int)(rng() % (w + 2 * margin)) - margin, y1 = (int)(rng() % (h + 2 * margin)) - margin;
+    return {name, x1, y1, x1 + 1 + (int)(rng() % 60), y1 + 1 + (int)(rng() % 60)};
+}
+
+// A partition reaching past the root, hit by the segment only outside it
+static void CheckOutsideRoot(FuzzCounts& counts) {
+    ChannelGraph graph;
+    makeChannelGraph(graph, {{"A", 0, 0, 100, 100}, {"B", 100, 0, 130, 100}});
+    QuadtreeNode tree(Vertex(0, 0, 120, 100, 0), &graph);
+    tree.Subdivide(10, 10, 2);
+    QueryCache cache(16, 16);
+    cache.Attach(&tree);
+    vector<int> fromTree, fromCache;
+    tree.NetIntersect(125, 10, 125, 90, fromTree);
+    cache.NetIntersect(125, 10, 125, 90, fromCache);
+    Compare("NetIntersect", 125, 10, 125, 90, fromTree, fromCache, counts);
+    tree.RectQuery(121, 10, 129, 90, fromTree);
+    cache.RectQuery(121, 10, 129, 90, fromCache);
+    Compare("RectQuery", 121, 10, 129, 90, fromTree, fromCache, counts);
+}
+
+static void FuzzRound(const FuzzOptions& options, int round, mt19937& rng, FuzzCounts& counts) {
+    int w = 64 + (int)(rng() % 200), h = 64 + (int)(rng() % 200);
+    vector<Partition> partitions;
+    int n = 5 + (int)(rng() % 40);
+    for (int i = 0; i < n; ++i) partitions.push_back(RandomBox(rng, "P" + to_string(i), w, h, 30));
+
+    ChannelGraph graph;
+    makeChannelGraph(graph, partitions);
+    QuadtreeNode tree(Vertex(0, 0, w, h, 0), &graph);
+    tree.SetPartitionIndex(round % 2 ? PartitionIndex::Enclosing : PartitionIndex::Leaves);
+    tree.Subdivide(8 + (int)(rng() % 20), 8 + (int)(rng() % 20), 2);
+    QueryCache cache(64, 1 + (int)(rng() % 20));
+    cache.Attach(&tree);
+
+    vector<int> fromTree, fromCache;
+    for (int q = 0; q < options.queries; ++q) {
+        if (q % 100 == 99) {
+            int pid = (int)(rng() % boost::num_vertices(graph));
+            Partition p = RandomBox(rng, "E" + to_string(q), w, h, 30);
+            switch (rng() % 3) {
+            case 0: tree.AddPartition(p); break;
+            case 1: tree.RemovePartition(pid); break;
+            default: tree.ResizePartition(pid, p.x1, p.y1, p.x2, p.y2); break;
+            }
+        }
+        int x1 = (int)(rng() % (w + 80)) - 40, y1 = (int)(rng() % (h + 80)) - 40;
+        int x2 = (int)(rng() % (w + 80)) - 40, y2 = (int)(rng() % (h + 80)) - 40;
+        if (rng() % 2) {
+            tree.RectQuery(x1, y1, x2, y2, fromTree);
+            cache.RectQuery(x1, y1, x2, y2, fromCache);
+            Compare("RectQuery", x1, y1, x2, y2, fromTree, fromCache, counts);
+        } else {
+            tree.NetIntersect(x1, y1, x2, y2, fromTree);
+            cache.NetIntersect(x1, y1, x2, y2, fromCache);
+            Compare("NetIntersect", x1, y1, x2, y2, fromTree, fromCache, counts);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    FuzzOptions options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--rounds")) options.rounds = max(1, atoi(argv[i + 1]));
+        else if (!strcmp(argv[i], "--queries")) options.queries = max(1, atoi(argv[i + 1]));
+        else if (!strcmp(argv[i], "--seed")) options.seed = (unsigned)strtoul(argv[i + 1], nullptr, 10);
+        else {
+            cerr << "Unknown option " << argv[i] << "\n";
+            return 1;
+        }
+    }
+
+    FuzzCounts counts;
+    CheckOutsideRoot(counts);
+    mt19937 rng(options.seed);
+    for (int round = 0; round < options.rounds; ++round) FuzzRound(options, round, rng, counts);
+
+    bool pass = counts.rectFailures == 0 && counts.netFailures == 0;
+    cout << (pass ? "[PASS] " : "[FAIL] ") << counts.checked << " queries, " << counts.rectFailures
+         << " RectQuery and " << counts.netFailures << " NetIntersect mismatches (seed " << options.seed << ")\n";
+    return pass ? 0 : 1;
+}
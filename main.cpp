@@ -1,7 +1,21 @@
 #include <iostream>
 #include <chrono>
+#include <random>
 #include "Quadtree.h"
 #include "ChannelGraph.h"
+#include "FlatQuadtree.h"
+#include "CompactChannelGraph.h"
+#include "ChannelRouter.h"
+#include "Snapshot.h"
+#include "MortonQuadtree.h"
+#include "ConcurrentQuadtree.h"
+#include "Loader.h"
+#include "QueryCache.h"
+#include "BasicQuadtree.h"
+#include "ChannelCongestion.h"
+#include <thread>
+#include <atomic>
+#include <fstream>
 
 
 using namespace std;
@@ -44,10 +58,125 @@ void CheckCurrentTreeCorrectness(const QuadtreeNode* root) {
         cout << "[SKIPPED] No test defined for region size "
              << w << "x" << h << "\n";
     }
+
+    // Segments along leaf borders touch partitions on both sides; PathQuery
+    // must report the same ones as NetIntersect
+    const vector<QuadtreeNode*>& leaves = root->GetLeafNodes();
+    size_t step = max<size_t>(leaves.size() / 1024, 1), checked = 0, mismatched = 0;
+    vector<int> expected;
+    PathQueryResult walked;
+    for (size_t i = 0; i < leaves.size(); i += step) {
+        const Vertex& r = leaves[i]->getRegion();
+        Point corners[4] = {{r.x, r.y}, {r.x + r.width, r.y}, {r.x + r.width, r.y + r.height}, {r.x, r.y + r.height}};
+        for (int side = 0; side < 4; ++side) {
+            Point a = corners[side], b = corners[(side + 1) % 4];
+            root->NetIntersect(a.x, a.y, b.x, b.y, expected);
+            root->PathQuery({{a, b}}, walked);
+            sort(expected.begin(), expected.end());
+            sort(walked.partitions.begin(), walked.partitions.end());
+            ++checked;
+            mismatched += expected != walked.partitions;
+        }
+    }
+    if (!mismatched)
+        cout << "[PASS] PathQuery matches NetIntersect on " << checked << " leaf-border segments\n";
+    else
+        cout << "[FAIL] PathQuery differs from NetIntersect on " << mismatched << " of " << checked
+             << " leaf-border segments\n";
+}
+
+// Prints the outcome of a point command the way the REPL has always shown it
+void PrintPointResult(const string& cmd, int x, int y, const PointResult& r, const function<string(int)>& partitionName) {
+    string at = "(" + to_string(x) + "," + to_string(y) + ")";
+    auto printPath = [&]() {
+        cout << "Path: ";
+        for (size_t i = 0; i < r.path.size(); ++i)
+            cout << r.path[i] << (i != r.path.size() - 1 ? " -> " : "");
+        cout << "\n";
+    };
+    auto printRegion = [&]() {
+        cout << "Node ID " << r.leafID << " region (" << r.region.x1 << "," << r.region.y1 << ") "
+             << r.region.x2 - r.region.x1 << "x" << r.region.y2 - r.region.y1 << "\n";
+    };
+
+    if (cmd == "InsertPoint") {
+        if (r.status == PointStatus::Ok) cout << "Inserted at node " << r.leafID << "\n";
+        else if (r.status == PointStatus::OutsideBoundary) cout << "Point " << at << " is outside the root boundary. Cannot insert.\n";
+        else cout << "Point " << at << " is outside all current leaf nodes. Cannot insert.\n";
+    } else if (cmd == "DeletePoint") {
+        if (r.status == PointStatus::Ok) cout << "Deleted point " << at << " from node " << r.leafID << "\n";
+        else if (r.status == PointStatus::NotFound) cout << "Point " << at << " is not stored in node " << r.leafID << ".\n";
+        else if (r.status == PointStatus::OutsideBoundary) cout << "Point " << at << " does not lie inside the tree.\n";
+        else cout << "No leaf node contains point " << at << ". Cannot delete.\n";
+    } else {
+        if (r.status == PointStatus::OutsideBoundary) {
+            cout << "Point " << at << " is outside this boundary.\n";
+            return;
+        }
+        if (r.status == PointStatus::NoLeaf) {
+            cout << "No leaf node contains " << at << ". Nearest region:\n";
+            printRegion();
+            printPath();
+            return;
+        }
+        printRegion();
+        cout << "Partitions: ";
+        for (int pid : r.partitions) cout << partitionName(pid) << " ";
+        if (r.partitions.empty()) cout << "None";
+        cout << "\n";
+        printPath();
+    }
+}
+
+void PrintPointResult(const string& cmd, int x, int y, const PointResult& r, const ChannelGraph& graph) {
+    PrintPointResult(cmd, x, y, r, [&](int pid) { return graph[pid].name; });
 }
 int main() {
     QuadtreeNode* tree = nullptr;
+    FlatQuadtree* flatTree = nullptr;
+    BasicQuadtree<int, 2> basicTree2;  // Compile-time fan-out trees; basicFanOut says which is built
+    BasicQuadtree<int, 4> basicTree4;
+    int basicFanOut = 0;
+    MappedSnapshot snapshot;
+    MortonQuadtree morton;
+    ConcurrentQuadtree concurrentTree;
     ChannelGraph graph;
+    CompactChannelGraph compactGraph;
+    bool useCompact = false;  // Build trees over compactGraph after FreezeGraph
+    PartitionIndex partitionIndex = PartitionIndex::Leaves;  // Applied to trees built afterwards
+    vector<pair<size_t, size_t>> verticalEdges;  // Stacked partitions, from makeChannelGraph
+    CompactChannelGraph routingGraph;  // Horizontal + vertical adjacency for Route
+    QueryCache queryCache(0);  // Off until the QueryCache command sets a capacity
+    // The cache when enabled, attached to the current tree (a new tree starts it empty)
+    auto cachedTree = [&]() -> QueryCache* {
+        if (!tree || !queryCache.Capacity()) return nullptr;
+        if (queryCache.Tree() != tree) queryCache.Attach(tree);
+        return &queryCache;
+    };
+    ChannelCongestion congestion;
+    int congestionPitch = 0;      // Track pitch set by the Congestion command (0 = off)
+    bool congestionStale = false; // Tree or partitions changed since the last Attach
+    bool partitionsRemoved = false; // The graph keeps tombstones the partition list no longer has
+    // The tracker when enabled, re-attached (usage kept) after the tree or partitions change
+    auto trackedTree = [&]() -> ChannelCongestion* {
+        if (!tree || !congestionPitch) return nullptr;
+        if (congestionStale || congestion.Tree() != tree) {
+            congestion.Attach(*tree, routingGraph, congestionPitch);
+            congestionStale = false;
+        }
+        return &congestion;
+    };
+    // Drops every tree built over the current partitions, for when their IDs change
+    auto dropTrees = [&]() {
+        delete tree;  // Also detaches the query cache
+        tree = nullptr;
+        morton = MortonQuadtree();
+        delete flatTree;
+        flatTree = nullptr;
+        basicFanOut = 0;
+        concurrentTree.Unpublish();
+    };
+    auto partitionName = [&](int pid) { return useCompact ? compactGraph.Name(pid) : graph[pid].name; };
     vector<Partition> partitions = {
         {"P1", 0, 0, 10, 100},
         {"P2", 10, 0, 20, 20},
@@ -67,7 +196,7 @@ int main() {
        
     };  
     while (true) {
-        cout << "\nCommand: MakeChannelGraph |Subdivide w h minW minH scale | InsertPoint x y | SearchPoint x y | DeletePoint x y | PathToRoot x y | RectQuery x1 y1 x2 y2 | NetIntersect x1 y1 x2 y2 | PrintDot | VerifyTree | PathRectQuery | Exit\n> ";
+        cout << "\nCommand: MakeChannelGraph | FreezeGraph |Subdivide w h minW minH scale | ParallelSubdivide w h minW minH scale threads | AdaptiveSubdivide w h minW minH scale | PartitionIndex leaves/enclosing | InsertPoint x y | BulkInsertPoints n threads (n x points) | RandomBulkInsert n seed threads | SearchPoint x y | DeletePoint x y | PointCapacity n | Log on/off | NearestPoints x y k | RadiusQuery x y r | PathToRoot x y | RectQuery x1 y1 x2 y2 | NetIntersect x1 y1 x2 y2 | BatchRectQuery n threads (n x rects) | BatchNetIntersect n threads (n x segments) | PrintDot | VerifyTree | Stats | QueryCache capacity grid | CacheStats | Congestion pitch | CommitNet x1 y1 x2 y2 | RipUpNet x1 y1 x2 y2 | CommitPath | CongestionWindow x1 y1 x2 y2 | PathRectQuery | PathQuery | Route x1 y1 x2 y2 | AddPartition name x1 y1 x2 y2 | RemovePartition name | ResizePartition name x1 y1 x2 y2 | FlatSubdivide w h minW minH scale | FlatSearchPoint x y | FlatInsertPoint x y | FlatDeletePoint x y | FlatRectQuery x1 y1 x2 y2 | FlatNetIntersect x1 y1 x2 y2 | BasicSubdivide w h minW minH fanOut(2/4) | BasicSearchPoint x y | BasicRectQuery x1 y1 x2 y2 | BasicNetIntersect x1 y1 x2 y2 | LoadPartitions file mapped/buffered | SavePartitions file text/binary | LoadPins file mapped/buffered threads | LoadPath file mapped/buffered | RunWorkload file outFile mapped/buffered | SaveSnapshot file | LoadSnapshot file | SnapSearchPoint x y | SnapRectQuery x1 y1 x2 y2 | SnapNetIntersect x1 y1 x2 y2 | BuildMorton | MortonSearchPoint x y | MortonInsertPoint x y | PublishConcurrent | ConcurrentInsertPoint x y | ConcurrentSearchPoint x y | ConcurrentStress readers n | Exit\n> ";
         string cmd;
         cin >> cmd;
 
@@ -75,14 +204,36 @@ int main() {
 
         else if (cmd == "MakeChannelGraph") {
     graph = ChannelGraph();  // create a fresh, empty graph
-    makeChannelGraph(graph, partitions);
+    makeChannelGraph(graph, partitions, verticalEdges);
+    routingGraph.Build(graph, verticalEdges);
+    congestionStale = true;
+    useCompact = false;
     cout << "Channel graph created.\n";
+    if (partitionsRemoved) {  // IDs after a removed partition shift down by one
+        partitionsRemoved = false;
+        if (tree || flatTree || basicFanOut || concurrentTree.IsPublished()) {
+            dropTrees();
+            cout << "Trees built over the old partition IDs were dropped; run Subdivide again.\n";
+        }
+    }
+}
+else if (cmd == "FreezeGraph") {
+    if (!boost::num_vertices(graph)) {
+        cout << "Please run makechannelgraph first.\n";
+        continue;
+    }
+    compactGraph.Build(graph);
+    useCompact = true;
+    cout << "Frozen CSR graph: " << compactGraph.NumPartitions() << " partitions, "
+         << compactGraph.NumEdges() << " edges, " << compactGraph.MemoryBytes()
+         << " bytes. Subdivide now builds over it.\n";
 }
 
 else if (cmd == "Subdivide") {
     if (tree) {
         delete tree;    // delete old tree
         tree = nullptr;
+        morton = MortonQuadtree();  // It points into the old tree
     }
 
     int w, h, minW, minH, scale;
@@ -94,7 +245,9 @@ else if (cmd == "Subdivide") {
     }
 
     Vertex root(0, 0, w, h, 0);
-    tree = new QuadtreeNode(root, &graph);
+    tree = useCompact ? new QuadtreeNode(root, &compactGraph) : new QuadtreeNode(root, &graph);
+    tree->SetPartitionIndex(partitionIndex);
+    congestionStale = true;
     tree->GetLeafNodes().clear();
 
     auto start = chrono::high_resolution_clock::now();
@@ -104,45 +257,193 @@ else if (cmd == "Subdivide") {
     cout << "Quadtree created in " << elapsed.count() << " seconds.\n";
 }
 
+else if (cmd == "PartitionIndex") {
+    string mode; cin >> mode;
+    if (mode == "leaves") partitionIndex = PartitionIndex::Leaves;
+    else if (mode == "enclosing") partitionIndex = PartitionIndex::Enclosing;
+    else {
+        cout << "Usage: PartitionIndex leaves|enclosing\n";
+        continue;
+    }
+    cout << "Trees built from now on store partitions "
+         << (partitionIndex == PartitionIndex::Leaves ? "in every overlapping leaf" : "at their smallest enclosing node")
+         << ".\n";
+}
+else if (cmd == "AdaptiveSubdivide") {
+    delete tree;
+    tree = nullptr;
+    morton = MortonQuadtree();
+
+    int w, h, minW, minH, scale;
+    cin >> w >> h >> minW >> minH >> scale;
+
+    if (!boost::num_vertices(graph)) {
+        cout << "Please run makechannelgraph first.\n";
+        continue;
+    }
+
+    tree = useCompact ? new QuadtreeNode(Vertex(0, 0, w, h, 0), &compactGraph)
+                      : new QuadtreeNode(Vertex(0, 0, w, h, 0), &graph);
+    tree->SetPartitionIndex(partitionIndex);
+    congestionStale = true;
+    auto start = chrono::high_resolution_clock::now();
+    tree->Subdivide(minW, minH, scale, true);
+    auto end = chrono::high_resolution_clock::now();
+    chrono::duration<double> elapsed = end - start;
+    cout << "Adaptive quadtree created in " << elapsed.count() << " seconds ("
+         << tree->GetLeafNodes().size() << " leaves).\n";
+}
+else if (cmd == "ParallelSubdivide") {
+    delete tree;
+    tree = nullptr;
+    morton = MortonQuadtree();
+
+    int w, h, minW, minH, scale, threads;
+    cin >> w >> h >> minW >> minH >> scale >> threads;
+
+    if (!boost::num_vertices(graph)) {
+        cout << "Please run makechannelgraph first.\n";
+        continue;
+    }
+
+    tree = useCompact ? new QuadtreeNode(Vertex(0, 0, w, h, 0), &compactGraph)
+                      : new QuadtreeNode(Vertex(0, 0, w, h, 0), &graph);
+    tree->SetPartitionIndex(partitionIndex);
+    congestionStale = true;
+    auto start = chrono::high_resolution_clock::now();
+    tree->SubdivideParallel(minW, minH, scale, threads);
+    auto end = chrono::high_resolution_clock::now();
+    chrono::duration<double> elapsed = end - start;
+    cout << "Quadtree created in " << elapsed.count() << " seconds.\n";
+}
+
         else if (cmd == "InsertPoint") {
             int point_x, point_y; cin >> point_x >> point_y;
+            if (!tree) {
+                cout << "Tree not built yet.\n";
+                continue;
+            }
               auto start = chrono::high_resolution_clock::now();
-            tree->InsertPoint(point_x,point_y);
+            PointResult result = tree->InsertPoint(point_x,point_y);
               auto end = chrono::high_resolution_clock::now();
+              PrintPointResult(cmd, point_x, point_y, result, graph);
               chrono::duration<double> elapsed = end - start;
               cout << "Inserted Points  in " << elapsed.count() << " seconds.\n";
         }
         else if (cmd == "SearchPoint") {
             int point_x, point_y; cin >> point_x >> point_y;
-            vector<int>path;
+            if (!tree) {
+                cout << "Tree not built yet.\n";
+                continue;
+            }
            auto start = chrono::high_resolution_clock::now();
-           tree->SearchPoint(point_x,point_y,path);
+           QueryCache* cache = cachedTree();
+           PointResult result = cache ? cache->SearchPoint(point_x, point_y) : tree->SearchPoint(point_x,point_y);
              auto end = chrono::high_resolution_clock::now();
+             PrintPointResult(cmd, point_x, point_y, result, graph);
               chrono::duration<double> elapsed = end - start;
               cout << "Searching done " << elapsed.count() << " seconds.\n";
             
         }
         else if (cmd == "DeletePoint") {
             int point_x, point_y; cin >> point_x >> point_y;
+            if (!tree) {
+                cout << "Tree not built yet.\n";
+                continue;
+            }
             auto start = chrono::high_resolution_clock::now();
-            tree->DeletePoint(point_x, point_y);
+            PointResult result = tree->DeletePoint(point_x, point_y);
              auto end = chrono::high_resolution_clock::now();
+             PrintPointResult(cmd, point_x, point_y, result, graph);
               chrono::duration<double> elapsed = end - start;
               cout << "Deleted Points in" << elapsed.count() << " seconds.\n";
             
 
+        }
+        else if (cmd == "BulkInsertPoints" || cmd == "RandomBulkInsert") {
+            int count, threads; cin >> count;
+            vector<Point> pts;
+            pts.reserve(count);
+            if (cmd == "BulkInsertPoints") {
+                cin >> threads;
+                for (int i = 0; i < count; ++i) {
+                    int x, y; cin >> x >> y;
+                    pts.push_back({x, y});
+                }
+            } else {
+                unsigned seed; cin >> seed >> threads;
+                if (tree) {
+                    const Vertex& r = tree->getRegion();
+                    mt19937 rng(seed);
+                    uniform_int_distribution<int> dx(r.x, r.x + r.width), dy(r.y, r.y + r.height);
+                    for (int i = 0; i < count; ++i) pts.push_back({dx(rng), dy(rng)});
+                }
+            }
+            if (!tree) {
+                cout << "Tree not built yet.\n";
+                continue;
+            }
+            auto start = chrono::high_resolution_clock::now();
+            size_t inserted = tree->BulkInsertPoints(pts, threads);
+            auto end = chrono::high_resolution_clock::now();
+            chrono::duration<double> elapsed = end - start;
+            cout << "Inserted " << inserted << " of " << count << " points into "
+                 << tree->GetLeafNodes().size() << " leaves in " << elapsed.count() << " seconds ("
+                 << (elapsed.count() > 0 ? inserted / elapsed.count() : 0) << " points/s).\n";
+        }
+        else if (cmd == "Log") {
+            string mode; cin >> mode;
+            if (mode == "on") QuadtreeNode::SetLogger([](const string& msg) { cout << "[log] " << msg << "\n"; });
+            else QuadtreeNode::SetLogger(nullptr);
+            cout << "Tree diagnostics " << (mode == "on" ? "enabled" : "disabled") << ".\n";
+        }
+        else if (cmd == "PointCapacity") {
+            int capacity; cin >> capacity;
+            if (!tree) {
+                cout << "Tree not built yet.\n";
+                continue;
+            }
+            tree->SetPointCapacity(capacity);
+            cout << "Leaves now split above " << capacity << " points.\n";
+        }
+        else if (cmd == "NearestPoints" || cmd == "RadiusQuery") {
+            int point_x, point_y, arg; cin >> point_x >> point_y >> arg;
+            if (!tree) {
+                cout << "Tree not built yet.\n";
+                continue;
+            }
+            auto start = chrono::high_resolution_clock::now();
+            auto res = cmd == "NearestPoints" ? tree->NearestPoints(point_x, point_y, arg)
+                                              : tree->PointsInRadius(point_x, point_y, arg);
+            auto end = chrono::high_resolution_clock::now();
+            for (const auto& pt : res) cout << "(" << pt.first << "," << pt.second << ") ";
+            cout << "\n";
+            chrono::duration<double> elapsed = end - start;
+            cout << cmd << " done in " << elapsed.count() << " seconds.\n";
         }
         else if (cmd == "PathToRoot") {
             int point_x, point_y; cin >> point_x >> point_y;
-             vector<int>path;
-             
-           tree->PathToRoot( point_x, point_y,path);
+            if (!tree) {
+                cout << "Tree not built yet.\n";
+                continue;
+            }
+           PrintPointResult(cmd, point_x, point_y, tree->SearchPoint(point_x, point_y), graph);
         }
         else if (cmd == "RectQuery") {
             int x_top, y_top, x_bottom, y_bottom;cin >> x_top >> y_top >> x_bottom >> y_bottom;
+            if (!tree) {
+                cout << "Tree not built yet.\n";
+                continue;
+            }
              auto start = chrono::high_resolution_clock::now();
-            auto res = tree->RectQuery(x_top,y_top,x_bottom,y_bottom);
-            for (const auto& r : res) cout << r << " ";
+            if (QueryCache* cache = cachedTree()) {
+                vector<int> ids;
+                cache->RectQuery(x_top, y_top, x_bottom, y_bottom, ids);
+                for (int pid : ids) cout << partitionName(pid) << " ";
+            } else {
+                auto res = tree->RectQuery(x_top,y_top,x_bottom,y_bottom);
+                for (const auto& r : res) cout << r << " ";
+            }
             cout << "\n";
              auto end = chrono::high_resolution_clock::now();
               chrono::duration<double> elapsed = end - start;
@@ -151,23 +452,646 @@ else if (cmd == "Subdivide") {
         }
         else if (cmd == "NetIntersect") {
             int x1, y1, x2, y2; cin >> x1 >> y1 >> x2 >> y2;
+            if (!tree) {
+                cout << "Tree not built yet.\n";
+                continue;
+            }
 
+            if (QueryCache* cache = cachedTree()) {
+                vector<int> ids;
+                cache->NetIntersect(x1, y1, x2, y2, ids);
+                for (int pid : ids) cout << partitionName(pid) << " ";
+            } else {
           auto res=tree->NetIntersect(x1, y1, x2, y2);
             for (const auto& r : res) cout << r << " ";
+            }
             cout << "\n";
         }
+        else if (cmd == "BatchRectQuery" || cmd == "BatchNetIntersect") {
+            int count, threads; cin >> count >> threads;
+            vector<Rect> rects;
+            vector<Segment> segs;
+            for (int i = 0; i < count; ++i) {
+                int x1, y1, x2, y2; cin >> x1 >> y1 >> x2 >> y2;
+                if (cmd == "BatchRectQuery") rects.push_back({x1, y1, x2, y2});
+                else segs.push_back({{x1, y1}, {x2, y2}});
+            }
+            if (!tree) {
+                cout << "Tree not built yet.\n";
+                continue;
+            }
+            auto start = chrono::high_resolution_clock::now();
+            auto res = cmd == "BatchRectQuery" ? tree->RectQueryBatch(rects, threads)
+                                               : tree->NetIntersectBatch(segs, threads);
+            auto end = chrono::high_resolution_clock::now();
+            for (size_t i = 0; i < res.size(); ++i) {
+                cout << "#" << i << ": ";
+                for (int pid : res[i]) cout << graph[pid].name << " ";
+                cout << "\n";
+            }
+            chrono::duration<double> elapsed = end - start;
+            cout << cmd << " answered " << count << " queries in " << elapsed.count() << " seconds.\n";
+        }
         else if (cmd == "PrintDot") {
     if (!tree) std::cout << "No tree built yet.\n";
     else std::cout << tree->GetDotRepresentation();
 }
+else if (cmd == "Stats") {
+    if (!tree) {
+        cout << "Tree not built yet.\n";
+        continue;
+    }
+    TreeStats ts = tree->GetTreeStats();
+    cout << "Nodes " << ts.nodes << ", leaves " << ts.leaves << ", points " << ts.points << "\n";
+    cout << "Nodes per level:";
+    for (size_t l = 0; l < ts.nodesPerLevel.size(); ++l) cout << " L" << l << "=" << ts.nodesPerLevel[l];
+    auto printHistogram = [](const char* title, const vector<size_t>& histogram) {
+        cout << "\n" << title << ":";
+        for (size_t b = 0; b < histogram.size(); ++b) {
+            if (!histogram[b]) continue;
+            size_t lo = b ? (size_t)1 << (b - 1) : 0, hi = b ? ((size_t)1 << b) - 1 : 0;
+            cout << " [" << lo;
+            if (hi > lo) cout << "-" << hi;
+            cout << "]=" << histogram[b];
+        }
+    };
+    printHistogram("Points per leaf", ts.pointsHistogram);
+    printHistogram("Partitions per leaf", ts.partitionsHistogram);
+    cout << "\nPartition IDs stored " << ts.partitionRefs << " (" << ts.partitionRefs * 5 * sizeof(int)
+         << " bytes with their packed boxes), per leaf avg " << (ts.leaves ? (double)ts.partitionRefs / ts.leaves : 0.0)
+         << ", max " << ts.maxPartitionsPerLeaf << "\n";
+    if (QuadtreeNode::StatsEnabled()) {
+        const QueryStats& qs = QuadtreeNode::LastQueryStats();
+        cout << "Last query: " << qs.nodesVisited << " nodes visited, " << qs.leavesTested << " leaves tested, "
+             << qs.partitionTests << " partition tests, " << qs.duplicates << " duplicates suppressed, depth "
+             << qs.maxDepth << "\n";
+    } else {
+        cout << "Query counters not compiled in (build with -DQUADTREE_STATS).\n";
+    }
+}
+else if (cmd == "QueryCache") {
+    size_t capacity;
+    int grid;
+    cin >> capacity >> grid;
+    queryCache.Configure(capacity, grid);
+    queryCache.ResetStats();
+    if (capacity)
+        cout << "RectQuery, NetIntersect, SearchPoint and RunWorkload now go through a " << capacity
+             << "-entry cache" << (grid > 1 ? " snapped to a " + to_string(grid) + " grid" : "") << ".\n";
+    else
+        cout << "Query cache off.\n";
+}
+else if (cmd == "CacheStats") {
+    const QueryCacheStats& cs = queryCache.Stats();
+    size_t lookups = cs.hits + cs.misses;
+    cout << "Cache entries " << queryCache.Size() << "/" << queryCache.Capacity() << ", hits " << cs.hits
+         << ", misses " << cs.misses << " (hit rate " << (lookups ? 100.0 * cs.hits / lookups : 0.0)
+         << "%), evictions " << cs.evictions << ", invalidated " << cs.invalidated << "\n";
+}
+else if (cmd == "Congestion") {
+    int pitch; cin >> pitch;
+    congestionPitch = max(pitch, 0);
+    congestionStale = true;
+    ChannelCongestion* tracker = trackedTree();
+    if (!congestionPitch) cout << "Congestion tracking off.\n";
+    else if (!tracker) cout << "Congestion tracking starts once a tree is built.\n";
+    else
+        cout << "Tracking " << tracker->NumPartitions() << " partitions and " << tracker->NumEdges()
+             << " channel edges at track pitch " << congestionPitch << "; Route now avoids and commits used channels.\n";
+}
+else if (cmd == "CommitNet" || cmd == "RipUpNet" || cmd == "CommitPath") {
+    int x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+    if (cmd != "CommitPath") cin >> x1 >> y1 >> x2 >> y2;
+    ChannelCongestion* tracker = trackedTree();
+    if (!tracker) {
+        cout << "Build a tree and run Congestion pitch first.\n";
+        continue;
+    }
+    PathQueryResult used;
+    auto start = chrono::high_resolution_clock::now();
+    if (cmd == "CommitPath") tracker->CommitPath(*tree, path, 1, &used);
+    else tracker->CommitNet(*tree, x1, y1, x2, y2, cmd == "CommitNet" ? 1 : -1, &used);
+    auto end = chrono::high_resolution_clock::now();
+
+    cout << "Partitions (usage/capacity):";
+    for (int pid : used.partitions)
+        cout << " " << partitionName(pid) << "(" << tracker->Usage(pid) << "/" << tracker->Capacity(pid) << ")";
+    cout << "\nChannel edges:";
+    for (const auto& e : used.edges)
+        cout << " " << partitionName(e.first) << "-" << partitionName(e.second) << "("
+             << tracker->EdgeUsage(e.first, e.second) << "/" << tracker->EdgeCapacity(e.first, e.second) << ")";
+    chrono::duration<double> elapsed = end - start;
+    cout << "\n" << cmd << " done in " << elapsed.count() << " seconds.\n";
+}
+else if (cmd == "CongestionWindow") {
+    int x1, y1, x2, y2; cin >> x1 >> y1 >> x2 >> y2;
+    ChannelCongestion* tracker = trackedTree();
+    if (!tracker) {
+        cout << "Build a tree and run Congestion pitch first.\n";
+        continue;
+    }
+    auto start = chrono::high_resolution_clock::now();
+    CongestionSummary sum = tracker->Window(x1, y1, x2, y2);
+    auto end = chrono::high_resolution_clock::now();
+    cout << sum.partitions << " partitions, usage " << sum.usage << "/" << sum.capacity << " tracks, overflow "
+         << sum.overflow;
+    if (sum.peakPartition >= 0) cout << ", peak " << sum.peak << " in " << partitionName(sum.peakPartition);
+    chrono::duration<double> elapsed = end - start;
+    cout << "\nCongestionWindow done in " << elapsed.count() << " seconds.\n";
+}
 else if (cmd == "VerifyTree") {
     if (tree)
         CheckCurrentTreeCorrectness(tree);
     else
         cout << "Tree not built yet.\n";
 }
+else if (cmd == "FlatSubdivide") {
+    delete flatTree;
+    flatTree = nullptr;
+
+    int w, h, minW, minH, scale;
+    cin >> w >> h >> minW >> minH >> scale;
+
+    if (!boost::num_vertices(graph)) {
+        cout << "Please run makechannelgraph first.\n";
+        continue;
+    }
+
+    flatTree = new FlatQuadtree(Vertex(0, 0, w, h, 0), &graph);
+    auto start = chrono::high_resolution_clock::now();
+    flatTree->Subdivide(minW, minH, scale);
+    auto end = chrono::high_resolution_clock::now();
+    chrono::duration<double> elapsed = end - start;
+    cout << "Flat quadtree created in " << elapsed.count() << " seconds ("
+         << flatTree->NodeCount() << " nodes, " << flatTree->LeafCount() << " leaves, "
+         << flatTree->MemoryBytes() << " bytes).\n";
+}
+else if (cmd == "FlatSearchPoint" || cmd == "FlatInsertPoint" || cmd == "FlatDeletePoint" ||
+         cmd == "FlatRectQuery" || cmd == "FlatNetIntersect") {
+    int a, b, c = 0, d = 0;
+    cin >> a >> b;
+    bool pointCmd = cmd != "FlatRectQuery" && cmd != "FlatNetIntersect";
+    if (!pointCmd) cin >> c >> d;
+    if (!flatTree) {
+        cout << "Please run FlatSubdivide first.\n";
+        continue;
+    }
+    auto start = chrono::high_resolution_clock::now();
+    if (pointCmd) {
+        PointResult result = cmd == "FlatInsertPoint" ? flatTree->InsertPoint(a, b)
+                           : cmd == "FlatDeletePoint" ? flatTree->DeletePoint(a, b)
+                                                      : flatTree->SearchPoint(a, b);
+        PrintPointResult(cmd.substr(4), a, b, result, graph);
+    } else {
+        auto res = cmd == "FlatRectQuery" ? flatTree->RectQuery(a, b, c, d)
+                                          : flatTree->NetIntersect(a, b, c, d);
+        for (const auto& r : res) cout << r << " ";
+        cout << "\n";
+    }
+    auto end = chrono::high_resolution_clock::now();
+    chrono::duration<double> elapsed = end - start;
+    cout << cmd << " done in " << elapsed.count() << " seconds.\n";
+}
+else if (cmd == "BasicSubdivide") {
+    int w, h, minW, minH, fanOut;
+    cin >> w >> h >> minW >> minH >> fanOut;
+    if (!boost::num_vertices(graph)) {
+        cout << "Please run makechannelgraph first.\n";
+        continue;
+    }
+    if (fanOut != 2 && fanOut != 4) {
+        cout << "BasicSubdivide is compiled for fan-out 2 and 4.\n";
+        continue;
+    }
+    // Partition IDs stay ChannelGraph vertex indices
+    vector<BasicBox<int>> boxes;
+    for (auto v : boost::make_iterator_range(vertices(graph)))
+        boxes.push_back({graph[v].x1, graph[v].y1, graph[v].x2, graph[v].y2});
+    auto start = chrono::high_resolution_clock::now();
+    size_t nodes, bytes;
+    if (fanOut == 2) {
+        basicTree2 = BasicQuadtree<int, 2>(0, 0, w, h);
+        basicTree2.Build(boxes, minW, minH);
+        nodes = basicTree2.NodeCount();
+        bytes = basicTree2.MemoryBytes();
+    } else {
+        basicTree4 = BasicQuadtree<int, 4>(0, 0, w, h);
+        basicTree4.Build(boxes, minW, minH);
+        nodes = basicTree4.NodeCount();
+        bytes = basicTree4.MemoryBytes();
+    }
+    basicFanOut = fanOut;
+    auto end = chrono::high_resolution_clock::now();
+    chrono::duration<double> elapsed = end - start;
+    cout << "Fan-out " << fanOut << " quadtree created in " << elapsed.count() << " seconds (" << nodes
+         << " nodes, " << bytes << " bytes).\n";
+}
+else if (cmd == "BasicSearchPoint" || cmd == "BasicRectQuery" || cmd == "BasicNetIntersect") {
+    int a, b, c = 0, d = 0;
+    cin >> a >> b;
+    if (cmd != "BasicSearchPoint") cin >> c >> d;
+    if (!basicFanOut) {
+        cout << "Please run BasicSubdivide first.\n";
+        continue;
+    }
+    auto run = [&](const auto& basic) {
+        vector<int> ids;
+        auto start = chrono::high_resolution_clock::now();
+        if (cmd == "BasicSearchPoint") {
+            vector<int> path;
+            basic.PathToRoot(a, b, path);
+            int leaf = basic.SearchPoint(a, b, ids);
+            auto end = chrono::high_resolution_clock::now();
+            if (leaf < 0) {
+                cout << "Point (" << a << "," << b << ") is outside this boundary.\n";
+            } else {
+                cout << "Node ID " << leaf << "\nPartitions: ";
+                for (int pid : ids) cout << graph[pid].name << " ";
+                if (ids.empty()) cout << "None";
+                cout << "\nPath: ";
+                for (size_t i = 0; i < path.size(); ++i) cout << path[i] << (i + 1 < path.size() ? " -> " : "");
+                cout << "\n";
+            }
+            chrono::duration<double> elapsed = end - start;
+            cout << cmd << " done in " << elapsed.count() << " seconds.\n";
+            return;
+        }
+        if (cmd == "BasicRectQuery") basic.RectQuery(a, b, c, d, ids);
+        else basic.NetIntersect(a, b, c, d, ids);
+        auto end = chrono::high_resolution_clock::now();
+        for (int pid : ids) cout << graph[pid].name << " ";
+        cout << "\n";
+        chrono::duration<double> elapsed = end - start;
+        cout << cmd << " done in " << elapsed.count() << " seconds.\n";
+    };
+    if (basicFanOut == 2) run(basicTree2);
+    else run(basicTree4);
+}
+else if (cmd == "PathQuery") {
+    if (!tree) {
+        cout << "Tree not built yet.\n";
+        continue;
+    }
+    PathQueryResult result;
+    auto start = chrono::high_resolution_clock::now();
+    tree->PathQuery(path, result);
+    auto end = chrono::high_resolution_clock::now();
+
+    cout << "Partitions along path: ";
+    for (int pid : result.partitions) cout << graph[pid].name << " ";
+    cout << "\nChannel edges used: ";
+    for (const auto& e : result.edges) cout << graph[e.first].name << "-" << graph[e.second].name << " ";
+    cout << "\n";
+    chrono::duration<double> elapsed = end - start;
+    cout << "PathQuery done in " << elapsed.count() << " seconds.\n";
+}
+else if (cmd == "AddPartition" || cmd == "RemovePartition" || cmd == "ResizePartition") {
+    string name; cin >> name;
+    int x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+    if (cmd != "RemovePartition") cin >> x1 >> y1 >> x2 >> y2;
+    if (!tree) {
+        cout << "Tree not built yet.\n";
+        continue;
+    }
+    if (useCompact) {
+        cout << "Graph is frozen; run MakeChannelGraph and Subdivide before editing.\n";
+        continue;
+    }
+    int pid = -1;
+    for (size_t v = 0; v < boost::num_vertices(graph); ++v)
+        if (graph[v].name == name) pid = (int)v;
+    if (cmd == "AddPartition" ? pid >= 0 : pid < 0) {
+        cout << "Partition " << name << (pid >= 0 ? " already exists.\n" : " not found.\n");
+        continue;
+    }
+
+    PartitionNeighbours touching;
+    bool ok = true;
+    auto start = chrono::high_resolution_clock::now();
+    if (cmd == "AddPartition") {
+        pid = tree->AddPartition({name, x1, y1, x2, y2}, &touching);
+        ok = pid >= 0;
+    } else if (cmd == "RemovePartition") {
+        ok = tree->RemovePartition(pid);
+    } else {
+        ok = tree->ResizePartition(pid, x1, y1, x2, y2, &touching);
+    }
+    auto end = chrono::high_resolution_clock::now();
+    if (!ok) {
+        cout << cmd << " failed.\n";
+        continue;
+    }
+
+    // Keep the partition list (with the box as the tree normalized it), the
+    // stacked pairs and the routing copy in step
+    auto named = find_if(partitions.begin(), partitions.end(),
+                         [&](const Partition& p) { return p.name == name; });
+    if (cmd == "RemovePartition") {
+        if (named != partitions.end()) partitions.erase(named);
+        partitionsRemoved = true;
+    } else if (named != partitions.end()) {
+        *named = graph[pid];
+    } else {
+        partitions.push_back(graph[pid]);
+    }
+    verticalEdges.erase(remove_if(verticalEdges.begin(), verticalEdges.end(),
+                                  [&](const pair<size_t, size_t>& e) { return (int)e.first == pid || (int)e.second == pid; }),
+                        verticalEdges.end());
+    for (int other : touching.vertical)
+        verticalEdges.push_back({(size_t)min(pid, other), (size_t)max(pid, other)});
+    routingGraph.Build(graph, verticalEdges);
+    congestionStale = true;
+
+    chrono::duration<double> elapsed = end - start;
+    if (cmd != "RemovePartition") {
+        cout << name << " touches:";
+        for (int other : touching.horizontal) cout << " " << graph[other].name;
+        for (int other : touching.vertical) cout << " " << graph[other].name << "(stacked)";
+        if (touching.horizontal.empty() && touching.vertical.empty()) cout << " None";
+        cout << "\n";
+    }
+    cout << cmd << " done in " << elapsed.count() << " seconds.\n";
+}
+else if (cmd == "Route") {
+    int x1, y1, x2, y2; cin >> x1 >> y1 >> x2 >> y2;
+    if (!tree) {
+        cout << "Tree not built yet.\n";
+        continue;
+    }
+    ChannelRouter router(routingGraph);
+    ChannelRoute route;
+    // With congestion tracking on, routes steer around used channels and are committed
+    ChannelCongestion* tracker = trackedTree();
+    vector<double> penalty;
+    if (tracker) {
+        tracker->Penalties(penalty);
+        router.SetCongestion(&penalty);
+    }
+    auto start = chrono::high_resolution_clock::now();
+    router.Route(*tree, {x1, y1}, {x2, y2}, route);
+    if (tracker) tracker->CommitRoute(route);
+    auto end = chrono::high_resolution_clock::now();
+    if (!route.found) {
+        cout << "No channel route found.\n";
+    } else {
+        cout << "Route (cost " << route.cost << "): ";
+        for (size_t i = 0; i < route.partitions.size(); ++i)
+            cout << graph[route.partitions[i]].name << (i + 1 < route.partitions.size() ? " -> " : "");
+        cout << (tracker ? " (committed)" : "") << "\n";
+    }
+    chrono::duration<double> elapsed = end - start;
+    cout << "Route done in " << elapsed.count() << " seconds.\n";
+}
+else if (cmd == "LoadPartitions" || cmd == "LoadPins" || cmd == "LoadPath") {
+    string file, mode; cin >> file >> mode;
+    int threads = 0;
+    if (cmd == "LoadPins") cin >> threads;
+    FileAccess access = mode == "buffered" ? FileAccess::Buffered : FileAccess::Mapped;
+    if (cmd == "LoadPins" && !tree) {
+        cout << "Tree not built yet.\n";
+        continue;
+    }
+    string error;
+    vector<Partition> loadedPartitions;
+    vector<Point> loadedPoints;
+    auto start = chrono::high_resolution_clock::now();
+    bool ok = cmd == "LoadPartitions" ? LoadPartitions(file, loadedPartitions, error, access)
+                                      : LoadPins(file, loadedPoints, error, access);
+    auto end = chrono::high_resolution_clock::now();
+    if (!ok) {
+        cout << "Cannot load " << file << ": " << error << "\n";
+        continue;
+    }
+    chrono::duration<double> elapsed = end - start;
+    size_t records = cmd == "LoadPartitions" ? loadedPartitions.size() : loadedPoints.size();
+    cout << "Parsed " << records << " records in " << elapsed.count() << " seconds ("
+         << (elapsed.count() > 0 ? records / elapsed.count() : 0) << " records/s).\n";
+
+    if (cmd == "LoadPartitions") {
+        // Same steps as MakeChannelGraph, over the loaded list
+        partitions = std::move(loadedPartitions);
+        start = chrono::high_resolution_clock::now();
+        graph = ChannelGraph();
+        makeChannelGraph(graph, partitions, verticalEdges);
+        routingGraph.Build(graph, verticalEdges);
+        congestionStale = true;
+        useCompact = false;
+        partitionsRemoved = false;
+        end = chrono::high_resolution_clock::now();
+        elapsed = end - start;
+        cout << "Channel graph created (" << boost::num_edges(graph) << " edges) in " << elapsed.count() << " seconds.\n";
+        if (tree || flatTree || basicFanOut || concurrentTree.IsPublished()) {
+            dropTrees();
+            cout << "Trees built over the old partitions were dropped; run Subdivide again.\n";
+        }
+    } else if (cmd == "LoadPath") {
+        // Consecutive points are joined into the net's segments
+        path.clear();
+        for (size_t i = 1; i < loadedPoints.size(); ++i) path.push_back({loadedPoints[i - 1], loadedPoints[i]});
+        cout << "Net path has " << path.size() << " segments.\n";
+    } else {
+        start = chrono::high_resolution_clock::now();
+        size_t inserted = tree->BulkInsertPoints(loadedPoints, threads);
+        end = chrono::high_resolution_clock::now();
+        elapsed = end - start;
+        cout << "Inserted " << inserted << " of " << loadedPoints.size() << " pins in " << elapsed.count() << " seconds.\n";
+    }
+}
+else if (cmd == "SavePartitions") {
+    string file, format; cin >> file >> format;
+    if (SavePartitions(file, partitions, format == "binary"))
+        cout << "Wrote " << partitions.size() << " partitions to " << file << ".\n";
+    else
+        cout << "Cannot write " << file << ".\n";
+}
+else if (cmd == "RunWorkload") {
+    string file, outFile, mode; cin >> file >> outFile >> mode;
+    if (!tree) {
+        cout << "Tree not built yet.\n";
+        continue;
+    }
+    string error;
+    vector<WorkloadQuery> queries;
+    auto start = chrono::high_resolution_clock::now();
+    bool ok = LoadWorkload(file, queries, error, mode == "buffered" ? FileAccess::Buffered : FileAccess::Mapped);
+    auto end = chrono::high_resolution_clock::now();
+    if (!ok) {
+        cout << "Cannot load " << file << ": " << error << "\n";
+        continue;
+    }
+    ofstream results(outFile, ios::binary | ios::trunc);
+    if (!results) {
+        cout << "Cannot write " << outFile << ".\n";
+        continue;
+    }
+    chrono::duration<double> elapsed = end - start;
+    WorkloadReport report = RunWorkload(*tree, queries, results, cachedTree());
+    cout << "Parsed " << queries.size() << " queries in " << elapsed.count() << " seconds.\n";
+    cout << "Ran " << report.queries << " queries (" << report.results << " results) in " << report.seconds
+         << " seconds: " << (report.seconds > 0 ? report.queries / report.seconds : 0) << " queries/s.\n";
+}
+else if (cmd == "SaveSnapshot") {
+    string file; cin >> file;
+    if (!tree) {
+        cout << "Tree not built yet.\n";
+        continue;
+    }
+    auto start = chrono::high_resolution_clock::now();
+    bool ok = WriteSnapshot(*tree, graph, file);
+    auto end = chrono::high_resolution_clock::now();
+    chrono::duration<double> elapsed = end - start;
+    if (ok) cout << "Snapshot written to " << file << " in " << elapsed.count() << " seconds.\n";
+    else cout << "Cannot write snapshot " << file << ".\n";
+}
+else if (cmd == "LoadSnapshot") {
+    string file, error; cin >> file;
+    auto start = chrono::high_resolution_clock::now();
+    bool ok = snapshot.Open(file, error);
+    auto end = chrono::high_resolution_clock::now();
+    chrono::duration<double> elapsed = end - start;
+    if (ok) cout << "Snapshot mapped (" << snapshot.NodeCount() << " nodes, " << snapshot.PartitionCount()
+                 << " partitions) in " << elapsed.count() << " seconds.\n";
+    else cout << "Cannot load snapshot: " << error << "\n";
+}
+else if (cmd == "SnapSearchPoint" || cmd == "SnapRectQuery" || cmd == "SnapNetIntersect") {
+    int a, b, c = 0, d = 0;
+    cin >> a >> b;
+    if (cmd != "SnapSearchPoint") cin >> c >> d;
+    if (!snapshot.IsOpen()) {
+        cout << "Please run LoadSnapshot first.\n";
+        continue;
+    }
+    auto start = chrono::high_resolution_clock::now();
+    if (cmd == "SnapSearchPoint") {
+        PointResult result = snapshot.SearchPoint(a, b);
+        PrintPointResult("SearchPoint", a, b, result, [&](int pid) { return snapshot.PartitionName(pid); });
+    } else {
+        auto res = cmd == "SnapRectQuery" ? snapshot.RectQuery(a, b, c, d)
+                                          : snapshot.NetIntersect(a, b, c, d);
+        for (const auto& r : res) cout << r << " ";
+        cout << "\n";
+    }
+    auto end = chrono::high_resolution_clock::now();
+    chrono::duration<double> elapsed = end - start;
+    cout << cmd << " done in " << elapsed.count() << " seconds.\n";
+}
+else if (cmd == "PublishConcurrent") {
+    if (!tree) {
+        cout << "Tree not built yet.\n";
+        continue;
+    }
+    auto start = chrono::high_resolution_clock::now();
+    concurrentTree.Publish(*tree, graph);
+    auto end = chrono::high_resolution_clock::now();
+    chrono::duration<double> elapsed = end - start;
+    cout << "Published tree for concurrent access (" << concurrentTree.PointCount() << " points carried over) in "
+         << elapsed.count() << " seconds.\n";
+}
+else if (cmd == "ConcurrentInsertPoint" || cmd == "ConcurrentSearchPoint") {
+    int point_x, point_y; cin >> point_x >> point_y;
+    if (!concurrentTree.IsPublished()) {
+        cout << "Please run PublishConcurrent first.\n";
+        continue;
+    }
+    auto start = chrono::high_resolution_clock::now();
+    PointResult result = cmd == "ConcurrentInsertPoint" ? concurrentTree.InsertPoint(point_x, point_y)
+                                                        : concurrentTree.SearchPoint(point_x, point_y);
+    auto end = chrono::high_resolution_clock::now();
+    PrintPointResult(cmd == "ConcurrentInsertPoint" ? "InsertPoint" : "SearchPoint", point_x, point_y, result, graph);
+    chrono::duration<double> elapsed = end - start;
+    cout << cmd << " done in " << elapsed.count() << " seconds.\n";
+}
+else if (cmd == "ConcurrentStress") {
+    int readers, count; cin >> readers >> count;
+    if (!tree || !concurrentTree.IsPublished()) {
+        cout << "Please run PublishConcurrent first.\n";
+        continue;
+    }
+    // Readers run count RectQuery + SearchPoint pairs each while one writer
+    // keeps inserting and deleting random points
+    const Vertex& r = tree->getRegion();
+    atomic<bool> readersDone(false);
+    atomic<size_t> writes(0);
+    auto start = chrono::high_resolution_clock::now();
+    thread writer([&]() {
+        mt19937 rng(1);
+        uniform_int_distribution<int> dx(r.x, r.x + r.width), dy(r.y, r.y + r.height);
+        while (!readersDone) {
+            int x = dx(rng), y = dy(rng);
+            concurrentTree.InsertPoint(x, y);
+            concurrentTree.DeletePoint(x, y);
+            writes += 2;
+        }
+    });
+    vector<thread> pool;
+    for (int t = 0; t < readers; ++t) {
+        pool.emplace_back([&, t]() {
+            mt19937 rng(100 + t);
+            uniform_int_distribution<int> dx(r.x, r.x + r.width), dy(r.y, r.y + r.height);
+            vector<int> out;
+            for (int i = 0; i < count; ++i) {
+                int x = dx(rng), y = dy(rng);
+                concurrentTree.RectQuery(x, y, x + r.width / 20, y + r.height / 20, out);
+                concurrentTree.SearchPoint(x, y);
+            }
+        });
+    }
+    for (auto& th : pool) th.join();
+    auto end = chrono::high_resolution_clock::now();
+    readersDone = true;
+    writer.join();
+    chrono::duration<double> elapsed = end - start;
+    cout << readers << " readers ran " << 2.0 * readers * count << " queries ("
+         << 2.0 * readers * count / elapsed.count() << " queries/s) alongside " << writes
+         << " writes in " << elapsed.count() << " seconds.\n";
+}
+else if (cmd == "BuildMorton") {
+    string error;
+    if (!tree) {
+        cout << "Tree not built yet.\n";
+        continue;
+    }
+    auto start = chrono::high_resolution_clock::now();
+    bool ok = morton.Build(*tree, error);
+    auto end = chrono::high_resolution_clock::now();
+    chrono::duration<double> elapsed = end - start;
+    if (ok) cout << "Morton index built (depth " << morton.Depth() << ") in " << elapsed.count() << " seconds.\n";
+    else cout << "Cannot build Morton index: " << error << "\n";
+}
+else if (cmd == "MortonSearchPoint" || cmd == "MortonInsertPoint") {
+    int point_x, point_y; cin >> point_x >> point_y;
+    if (!morton.IsBuilt()) {
+        cout << "Please run BuildMorton first.\n";
+        continue;
+    }
+    if (!morton.IsCurrent()) {
+        cout << "Tree leaves changed since BuildMorton; run BuildMorton again.\n";
+        continue;
+    }
+    auto start = chrono::high_resolution_clock::now();
+    if (cmd == "MortonInsertPoint") {
+        PrintPointResult("InsertPoint", point_x, point_y, morton.InsertPoint(point_x, point_y), graph);
+    } else {
+        vector<int> path;
+        if (!morton.PathToRoot(point_x, point_y, path)) {
+            cout << "Point (" << point_x << "," << point_y << ") is outside this boundary.\n";
+        } else {
+            const Vertex& r = morton.LocateLeaf(point_x, point_y)->getRegion();
+            cout << "Node ID " << path.back() << " region (" << r.x << "," << r.y << ") "
+                 << r.width << "x" << r.height << "\nPath: ";
+            for (size_t i = 0; i < path.size(); ++i)
+                cout << path[i] << (i != path.size() - 1 ? " -> " : "");
+            cout << "\n";
+        }
+    }
+    auto end = chrono::high_resolution_clock::now();
+    chrono::duration<double> elapsed = end - start;
+    cout << cmd << " done in " << elapsed.count() << " seconds.\n";
+}
 else if (cmd == "PathRectQuery") {
-    if (path.empty()) {
+    if (!tree) {
+        cout << "Tree not built yet.\n";
+    } else if (path.empty()) {
         cout << "Path vector is empty.\n";
     } else {
         